@@ -0,0 +1,123 @@
+#include "adaptive_tuner.h"
+#include "logger.h"
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+
+//       
+static const double RATE_TOLERANCE = 0.05;
+//  ,     
+static const double CONVERGED_FACTOR = 1.1;
+//  ,    
+static const double RETUNE_DROP = 0.7;
+
+TuningRange::TuningRange(long long min, long long max)
+    : min(min), max(max), max_latency(0) {
+}
+
+TuningRange& TuningRange::operator=(const json& j) {
+    if (!j.is_object())
+        throw std::domain_error("Tuning range must be an object (json id=302)");
+
+    min = j.value("min", min);
+    max = j.value("max", max);
+    max_latency = j.value("max_latency", 0.0);
+
+    if (min < 1 || max < min || max_latency < 0)
+        throw std::domain_error("Tuning range requires 1 <= min <= max and non-negative max_latency (json id=302)");
+
+    return *this;
+}
+
+AdaptiveTuner::AdaptiveTuner(const std::string& name, long long initial, const TuningRange& range,
+    int window, long long align)
+    : name_(name), range_(range), align_(std::max(1LL, align)), window_(std::max(1, window)),
+      value_(std::min(std::max(initial, range.min), range.max)),
+      samples_(0), units_(0), seconds_(0), factor_(2.0), direction_(1),
+      last_rate_(0), converged_rate_(0), converged_(false) {
+}
+
+long long AdaptiveTuner::value() const {
+    return value_;
+}
+
+bool AdaptiveTuner::converged() const {
+    return converged_;
+}
+
+long long AdaptiveTuner::update(long long units, double seconds) {
+    units_ += units;
+    seconds_ += seconds;
+    if (++samples_ < window_)
+        return value_;
+
+    double rate = seconds_ > 0 ? units_ / seconds_ : 0;
+    double latency = seconds_ / samples_;
+    samples_ = 0;
+    units_ = 0;
+    seconds_ = 0;
+
+    //   :  ,     
+    if (range_.max_latency > 0 && latency > range_.max_latency && value_ > range_.min) {
+        converged_ = false;
+        direction_ = -1;
+        last_rate_ = 0;
+        move();
+        return value_;
+    }
+
+    if (converged_) {
+        if (rate >= converged_rate_ * RETUNE_DROP)
+            return value_;
+
+        Logger::log(Logger::INFO, "AdaptiveTuner", name_ + ": throughput dropped, tuning resumed");
+        converged_ = false;
+        factor_ = 2.0;
+        last_rate_ = 0;
+    }
+
+    //  -    ;     -   
+    if (last_rate_ > 0) {
+        if (rate < last_rate_ * (1 - RATE_TOLERANCE)) {
+            direction_ = -direction_;
+            factor_ = std::sqrt(factor_);
+        }
+        else if (rate < last_rate_ * (1 + RATE_TOLERANCE)) {
+            factor_ = std::sqrt(factor_);
+        }
+    }
+    last_rate_ = rate;
+
+    if (factor_ < CONVERGED_FACTOR) {
+        converged_ = true;
+        converged_rate_ = rate;
+
+        std::stringstream message;
+        message << name_ << " converged at " << value_ << " ("
+            << std::fixed << std::setprecision(0) << rate << " per second)";
+        Logger::log(Logger::INFO, "AdaptiveTuner", message.str());
+        return value_;
+    }
+
+    move();
+    return value_;
+}
+
+void AdaptiveTuner::move() {
+    double next = direction_ > 0 ? value_ * factor_ : value_ / factor_;
+    long long aligned = (long long)std::llround(next / align_) * align_;
+    aligned = std::min(std::max(aligned, range_.min), range_.max);
+
+    //        -    
+    if (aligned == value_) {
+        direction_ = -direction_;
+        factor_ = std::sqrt(factor_);
+    }
+    value_ = aligned;
+}
+
+std::string AdaptiveTuner::report() const {
+    return name_ + "=" + std::to_string(value_) + (converged_ ? "" : " (not converged)");
+}
@@ -0,0 +1,63 @@
+/*
+* ================== ADAPTIVE_TUNER ==================
+*    ( ,  ,
+*  )   .    
+*     ;   
+*        
+*   ,     .
+*   max_latency    
+* .     .
+*/
+
+#pragma once
+
+#ifndef ADAPTIVE_TUNER_H
+#define ADAPTIVE_TUNER_H
+
+#include <string>
+#include "external/json.hpp"
+
+using json = nlohmann::json;
+
+//    
+struct TuningRange {
+    long long min;
+    long long max;
+    double max_latency;     //    ,  (0 -  )
+
+    TuningRange(long long min, long long max);
+    TuningRange& operator=(const json& j);
+};
+
+class AdaptiveTuner {
+public:
+    AdaptiveTuner(const std::string& name, long long initial, const TuningRange& range,
+        int window = 4, long long align = 1);
+
+    long long value() const;
+    long long update(long long units, double seconds);     //    
+    bool converged() const;
+    std::string report() const;
+
+private:
+    std::string name_;
+    TuningRange range_;
+    long long align_;
+    int window_;
+    long long value_;
+
+    //    
+    int samples_;
+    long long units_;
+    double seconds_;
+
+    double factor_;
+    int direction_;
+    double last_rate_;
+    double converged_rate_;
+    bool converged_;
+
+    void move();
+};
+
+#endif // ADAPTIVE_TUNER_H
@@ -0,0 +1,715 @@
+#include "backup_io.h"
+#include "logger.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+//  ,     O_DIRECT
+static const size_t IO_ALIGNMENT = 4096;
+
+BackupIOConfig::BackupIOConfig()
+    : buffer_size(4 * 1024 * 1024), queue_depth(4), direct(false), use_io_uring(true),
+      adaptive(false), buffer_range(64 * 1024, 16 * 1024 * 1024) {
+}
+
+BackupIOConfig& BackupIOConfig::operator=(const json& j) {
+    if (!j.is_object())
+        throw std::domain_error("Backup io configuration must be an object");
+
+    buffer_size = j.value("buffer_size", (size_t)4 * 1024 * 1024);
+    queue_depth = j.value("queue_depth", 4);
+    direct = j.value("direct", false);
+    use_io_uring = j.value("io_uring", true);
+
+    adaptive = false;
+    if (j.contains("adaptive")) {
+        const json& adaptive_json = j["adaptive"];
+        if (adaptive_json.is_boolean()) {
+            adaptive = adaptive_json.get<bool>();
+        }
+        else {
+            buffer_range = adaptive_json;
+            adaptive = adaptive_json.value("enabled", true);
+        }
+    }
+
+    if (buffer_size == 0 || queue_depth < 2)
+        throw std::domain_error("Backup io buffer_size must be positive and queue_depth at least 2");
+    buffer_size = (buffer_size + IO_ALIGNMENT - 1) / IO_ALIGNMENT * IO_ALIGNMENT;
+    buffer_range.min = (buffer_range.min + IO_ALIGNMENT - 1) / IO_ALIGNMENT * IO_ALIGNMENT;
+    buffer_range.max = (buffer_range.max + IO_ALIGNMENT - 1) / IO_ALIGNMENT * IO_ALIGNMENT;
+
+    return *this;
+}
+
+//     
+class NativeFile {
+public:
+#ifdef __linux__
+    explicit NativeFile(int fd) : fd_(fd), direct_((fcntl(fd, F_GETFL) & O_DIRECT) != 0) {}
+    ~NativeFile() { ::close(fd_); }
+
+    int fd() const { return fd_; }
+
+    //  O_DIRECT     :   -  
+    bool at_end(size_t done) const { return direct_ && done % IO_ALIGNMENT != 0; }
+
+    size_t write_at(const char* data, size_t length, long long offset) {
+        size_t done = 0;
+        while (done < length) {
+            ssize_t n = ::pwrite(fd_, data + done, length - done, offset + done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) throw std::runtime_error("Backup file write failed: " + std::string(strerror(errno)));
+            done += n;
+        }
+        return done;
+    }
+
+    size_t read_at(char* data, size_t length, long long offset) {
+        size_t done = 0;
+        while (done < length) {
+            ssize_t n = ::pread(fd_, data + done, length - done, offset + done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) throw std::runtime_error("Backup file read failed: " + std::string(strerror(errno)));
+            if (n == 0) break;
+            done += n;
+            if (at_end(done)) break;
+        }
+        return done;
+    }
+
+    void truncate(long long size) {
+        if (::ftruncate(fd_, size) != 0)
+            throw std::runtime_error("Backup file truncate failed: " + std::string(strerror(errno)));
+    }
+
+private:
+    int fd_;
+    bool direct_;
+#else
+    explicit NativeFile(FILE* file) : file_(file) {}
+    ~NativeFile() { fclose(file_); }
+
+    size_t write_at(const char* data, size_t length, long long offset) {
+        if (_fseeki64(file_, offset, SEEK_SET) != 0 || fwrite(data, 1, length, file_) != length)
+            throw std::runtime_error("Backup file write failed");
+        return length;
+    }
+
+    size_t read_at(char* data, size_t length, long long offset) {
+        if (_fseeki64(file_, offset, SEEK_SET) != 0)
+            throw std::runtime_error("Backup file read failed");
+        return fread(data, 1, length, file_);
+    }
+
+    void truncate(long long) {
+    }
+
+private:
+    FILE* file_;
+#endif
+};
+
+//    -
+class AsyncFile {
+public:
+    explicit AsyncFile(NativeFile* file) : file_(file) {}
+    virtual ~AsyncFile() {}
+
+    virtual void submit(size_t slot, bool write, char* data, size_t length, long long offset) = 0;
+    virtual size_t wait(size_t slot) = 0;
+
+    void truncate(long long size) { file_->truncate(size); }
+    NativeFile* release_file() { return file_.release(); }
+
+protected:
+    std::unique_ptr<NativeFile> file_;
+};
+
+//  :      
+class ThreadFile : public AsyncFile {
+public:
+    ThreadFile(NativeFile* file, size_t slots)
+        : AsyncFile(file), requests_(slots), stop_(false) {
+        worker_ = std::thread(&ThreadFile::run, this);
+    }
+
+    ~ThreadFile() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        worker_.join();
+    }
+
+    void submit(size_t slot, bool write, char* data, size_t length, long long offset) override {
+        std::lock_guard<std::mutex> lock(mtx_);
+        requests_[slot] = { write, data, length, offset, false, 0, "" };
+        queue_.push_back(slot);
+        cv_.notify_all();
+    }
+
+    size_t wait(size_t slot) override {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [&] { return requests_[slot].done; });
+        requests_[slot].done = false;
+        if (!requests_[slot].error.empty())
+            throw std::runtime_error(requests_[slot].error);
+        return requests_[slot].result;
+    }
+
+private:
+    struct Request {
+        bool write;
+        char* data;
+        size_t length;
+        long long offset;
+        bool done;
+        size_t result;
+        std::string error;
+    };
+
+    std::vector<Request> requests_;
+    std::deque<size_t> queue_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::thread worker_;
+    bool stop_;
+
+    void run() {
+        while (true) {
+            size_t slot;
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+                if (queue_.empty())
+                    return;
+                slot = queue_.front();
+                queue_.pop_front();
+                request = requests_[slot];
+            }
+
+            size_t result = 0;
+            std::string error;
+            try {
+                result = request.write ?
+                    file_->write_at(request.data, request.length, request.offset) :
+                    file_->read_at(request.data, request.length, request.offset);
+            }
+            catch (const std::exception& e) {
+                error = e.what();
+            }
+
+            std::lock_guard<std::mutex> lock(mtx_);
+            requests_[slot].result = result;
+            requests_[slot].error = error;
+            requests_[slot].done = true;
+            cv_.notify_all();
+        }
+    }
+};
+
+#ifdef __linux__
+// io_uring   :        
+class UringFile : public AsyncFile {
+public:
+    UringFile(NativeFile* file, size_t slots)
+        : AsyncFile(file), ring_fd_(-1), sq_ring_(nullptr), cq_ring_(nullptr), sqes_(nullptr),
+          sq_ring_size_(0), cq_ring_size_(0), sqes_size_(0), requests_(slots) {
+    }
+
+    ~UringFile() {
+        if (sqes_) munmap(sqes_, sqes_size_);
+        if (cq_ring_ && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+        if (sq_ring_) munmap(sq_ring_, sq_ring_size_);
+        if (ring_fd_ >= 0) ::close(ring_fd_);
+    }
+
+    bool init() {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ring_fd_ = (int)syscall(__NR_io_uring_setup, (unsigned)requests_.size(), &params);
+        if (ring_fd_ < 0)
+            return false;
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap)
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+
+        sq_ring_ = (char*)mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED) {
+            sq_ring_ = nullptr;
+            return false;
+        }
+
+        cq_ring_ = single_mmap ? sq_ring_ : (char*)mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            cq_ring_ = nullptr;
+            return false;
+        }
+
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = (io_uring_sqe*)mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+        if (sqes_ == MAP_FAILED) {
+            sqes_ = nullptr;
+            return false;
+        }
+
+        sq_tail_ = (unsigned*)(sq_ring_ + params.sq_off.tail);
+        sq_mask_ = (unsigned*)(sq_ring_ + params.sq_off.ring_mask);
+        sq_array_ = (unsigned*)(sq_ring_ + params.sq_off.array);
+        cq_head_ = (unsigned*)(cq_ring_ + params.cq_off.head);
+        cq_tail_ = (unsigned*)(cq_ring_ + params.cq_off.tail);
+        cq_mask_ = (unsigned*)(cq_ring_ + params.cq_off.ring_mask);
+        cqes_ = (io_uring_cqe*)(cq_ring_ + params.cq_off.cqes);
+        return true;
+    }
+
+    void submit(size_t slot, bool write, char* data, size_t length, long long offset) override {
+        Request& request = requests_[slot];
+        request.write = write;
+        request.data = data;
+        request.length = length;
+        request.offset = offset;
+        request.completed = 0;
+        enqueue(slot);
+    }
+
+    size_t wait(size_t slot) override {
+        Request& request = requests_[slot];
+        while (true) {
+            while (!request.done)
+                reap();
+            request.done = false;
+
+            if (request.result < 0)
+                throw std::runtime_error("Backup file I/O failed: " + std::string(strerror((int)-request.result)));
+
+            //   -   0 ;     
+            request.completed += (size_t)request.result;
+            if (request.result == 0 || request.completed == request.length ||
+                (!request.write && file_->at_end(request.completed)))
+                break;
+            enqueue(slot);
+        }
+
+        // ,   ,      
+        size_t done = request.completed;
+        if (request.write && done < request.length)
+            done += file_->write_at(request.data + done, request.length - done, request.offset + done);
+        return done;
+    }
+
+private:
+    struct Request {
+        bool write;
+        char* data;
+        size_t length;
+        long long offset;
+        size_t completed;
+        bool done;
+        long long result;
+        iovec iov;
+    };
+
+    int ring_fd_;
+    char* sq_ring_;
+    char* cq_ring_;
+    io_uring_sqe* sqes_;
+    size_t sq_ring_size_;
+    size_t cq_ring_size_;
+    size_t sqes_size_;
+    unsigned* sq_tail_;
+    unsigned* sq_mask_;
+    unsigned* sq_array_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned* cq_mask_;
+    io_uring_cqe* cqes_;
+    std::vector<Request> requests_;
+
+    //     
+    void enqueue(size_t slot) {
+        Request& request = requests_[slot];
+        request.done = false;
+        request.result = 0;
+        request.iov.iov_base = request.data + request.completed;
+        request.iov.iov_len = request.length - request.completed;
+
+        unsigned tail = *sq_tail_;
+        unsigned index = tail & *sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = request.write ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->fd = file_->fd();
+        sqe->off = request.offset + request.completed;
+        sqe->addr = (unsigned long long)&request.iov;
+        sqe->len = 1;
+        sqe->user_data = slot;
+        sq_array_[index] = index;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+        int submitted;
+        do {
+            submitted = (int)syscall(__NR_io_uring_enter, ring_fd_, 1, 0, 0, nullptr, 0);
+        } while (submitted < 0 && errno == EINTR);
+        if (submitted < 0)
+            throw std::runtime_error("io_uring submit failed: " + std::string(strerror(errno)));
+    }
+
+    void reap() {
+        unsigned head = *cq_head_;
+        while (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+            int res = (int)syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (res < 0 && errno != EINTR)
+                throw std::runtime_error("io_uring wait failed: " + std::string(strerror(errno)));
+        }
+
+        io_uring_cqe* cqe = &cqes_[head & *cq_mask_];
+        Request& request = requests_[(size_t)cqe->user_data];
+        request.result = cqe->res;
+        request.done = true;
+        __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    }
+};
+#endif
+
+static std::unique_ptr<AsyncFile> open_async_file(const std::string& path, bool write, BackupIOConfig& config) {
+#ifdef __linux__
+    int flags = write ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY;
+    int fd = ::open(path.c_str(), flags | (config.direct ? O_DIRECT : 0), 0644);
+    if (fd < 0 && config.direct) {
+        //      O_DIRECT (, tmpfs)
+        Logger::log(Logger::WARN, "BackupIO", "O_DIRECT is not supported for " + path + ", using buffered I/O");
+        config.direct = false;
+        fd = ::open(path.c_str(), flags, 0644);
+    }
+    if (fd < 0)
+        return nullptr;
+
+    NativeFile* file = new NativeFile(fd);
+    if (config.use_io_uring) {
+        std::unique_ptr<UringFile> uring(new UringFile(file, config.queue_depth));
+        if (uring->init())
+            return std::unique_ptr<AsyncFile>(uring.release());
+
+        //   io_uring     (,  )
+        Logger::log(Logger::WARN, "BackupIO", "io_uring is not available, using background thread I/O");
+        file = uring->release_file();
+    }
+    return std::unique_ptr<AsyncFile>(new ThreadFile(file, config.queue_depth));
+#else
+    config.direct = false;
+    FILE* handle = fopen(path.c_str(), write ? "wb" : "rb");
+    if (!handle)
+        return nullptr;
+    return std::unique_ptr<AsyncFile>(new ThreadFile(new NativeFile(handle), config.queue_depth));
+#endif
+}
+
+//          
+static size_t buffer_capacity(const BackupIOConfig& config) {
+    return config.adaptive ? std::max(config.buffer_size, (size_t)config.buffer_range.max) : config.buffer_size;
+}
+
+static std::unique_ptr<AdaptiveTuner> create_tuner(const std::string& name, const BackupIOConfig& config) {
+    if (!config.adaptive)
+        return nullptr;
+    return std::unique_ptr<AdaptiveTuner>(new AdaptiveTuner(name, (long long)config.buffer_size,
+        config.buffer_range, 4, (long long)IO_ALIGNMENT));
+}
+
+static void allocate_buffers(std::vector<IOBuffer>& buffers, const BackupIOConfig& config) {
+    buffers.resize(config.queue_depth);
+    for (auto& buffer : buffers) {
+        buffer.storage.resize(buffer_capacity(config) + IO_ALIGNMENT);
+        size_t shift = (IO_ALIGNMENT - (size_t)buffer.storage.data() % IO_ALIGNMENT) % IO_ALIGNMENT;
+        buffer.data = buffer.storage.data() + shift;
+        buffer.length = 0;
+        buffer.pending = false;
+    }
+}
+
+BackupWriter::BackupWriter(const std::string& path, const BackupIOConfig& config)
+    : config_(config), current_(0), offset_(0), block_size_(config.buffer_size) {
+    file_ = open_async_file(path, true, config_);
+    if (!file_)
+        return;
+
+    allocate_buffers(buffers_, config_);
+    tuner_ = create_tuner("Backup buffer_size", config_);
+    if (tuner_)
+        block_size_ = (size_t)tuner_->value();
+    last_submit_ = std::chrono::steady_clock::now();
+}
+
+BackupWriter::~BackupWriter() {
+    try {
+        close();
+    }
+    catch (const std::exception& e) {
+        Logger::log(Logger::ERROR, "BackupIO", "Error closing backup file: " + std::string(e.what()));
+    }
+}
+
+bool BackupWriter::is_open() const {
+    return file_ != nullptr;
+}
+
+void BackupWriter::write(const char* data, size_t length) {
+    while (length > 0) {
+        IOBuffer& buffer = buffers_[current_];
+        size_t n = std::min(length, block_size_ - buffer.length);
+        memcpy(buffer.data + buffer.length, data, n);
+        buffer.length += n;
+        data += n;
+        length -= n;
+
+        if (buffer.length == block_size_)
+            submit_current();
+    }
+}
+
+void BackupWriter::submit_current() {
+    IOBuffer& buffer = buffers_[current_];
+    size_t length = buffer.length;
+
+    //  O_DIRECT      ,    close
+    if (config_.direct && length % IO_ALIGNMENT != 0) {
+        size_t aligned = (length + IO_ALIGNMENT - 1) / IO_ALIGNMENT * IO_ALIGNMENT;
+        memset(buffer.data + length, 0, aligned - length);
+        length = aligned;
+    }
+
+    file_->submit(current_, true, buffer.data, length, offset_);
+    buffer.pending = true;
+    offset_ += buffer.length;
+
+    //  -        (     )
+    if (tuner_) {
+        auto now = std::chrono::steady_clock::now();
+        block_size_ = (size_t)tuner_->update((long long)buffer.length,
+            std::chrono::duration<double>(now - last_submit_).count());
+        last_submit_ = now;
+    }
+
+    current_ = (current_ + 1) % buffers_.size();
+    IOBuffer& next = buffers_[current_];
+    if (next.pending) {
+        file_->wait(current_);
+        next.pending = false;
+    }
+    next.length = 0;
+}
+
+void BackupWriter::close() {
+    if (!file_)
+        return;
+
+    if (buffers_[current_].length > 0)
+        submit_current();
+
+    for (size_t slot = 0; slot < buffers_.size(); slot++) {
+        if (buffers_[slot].pending) {
+            buffers_[slot].pending = false;
+            file_->wait(slot);
+        }
+    }
+
+    if (config_.direct)
+        file_->truncate(offset_);
+    file_.reset();
+}
+
+std::string BackupWriter::tuning_report() const {
+    return tuner_ ? tuner_->report() : "";
+}
+
+BackupReader::BackupReader(const std::string& path, const BackupIOConfig& config, long long offset, long long length)
+    : config_(config), current_(0), offset_(offset / (long long)IO_ALIGNMENT * (long long)IO_ALIGNMENT),
+      returned_(false), eof_(false), skip_((size_t)(offset % (long long)IO_ALIGNMENT)),
+      end_(length < 0 ? -1 : offset + length), remaining_(length), block_size_(config.buffer_size) {
+    file_ = open_async_file(path, false, config_);
+    if (!file_)
+        return;
+
+    allocate_buffers(buffers_, config_);
+    tuner_ = create_tuner("Restore buffer_size", config_);
+    if (tuner_)
+        block_size_ = (size_t)tuner_->value();
+    last_next_ = std::chrono::steady_clock::now();
+
+    for (size_t slot = 0; slot < buffers_.size(); slot++)
+        submit(slot);
+}
+
+BackupReader::~BackupReader() {
+    //        
+    for (size_t slot = 0; slot < buffers_.size(); slot++) {
+        if (buffers_[slot].pending) {
+            try {
+                file_->wait(slot);
+            }
+            catch (const std::exception&) { }
+        }
+    }
+}
+
+bool BackupReader::is_open() const {
+    return file_ != nullptr;
+}
+
+void BackupReader::submit(size_t slot) {
+    if (end_ >= 0 && offset_ >= end_)
+        return;
+
+    buffers_[slot].length = block_size_;
+    file_->submit(slot, false, buffers_[slot].data, block_size_, offset_);
+    buffers_[slot].pending = true;
+    offset_ += block_size_;
+}
+
+size_t BackupReader::next(const char*& data) {
+    // ,    ,     
+    if (returned_) {
+        if (!eof_)
+            submit(current_);
+        current_ = (current_ + 1) % buffers_.size();
+        returned_ = false;
+    }
+
+    IOBuffer& buffer = buffers_[current_];
+    if (!buffer.pending || remaining_ == 0)
+        return 0;
+
+    size_t requested = buffer.length;
+    buffer.pending = false;
+    buffer.length = file_->wait(current_);
+    if (buffer.length < requested)
+        eof_ = true;
+    if (buffer.length == 0)
+        return 0;
+
+    //  -        (   )
+    if (tuner_) {
+        auto now = std::chrono::steady_clock::now();
+        block_size_ = (size_t)tuner_->update((long long)buffer.length,
+            std::chrono::duration<double>(now - last_next_).count());
+        last_next_ = now;
+    }
+
+    //      ,  -    
+    size_t length = buffer.length;
+    data = buffer.data;
+    if (skip_ > 0) {
+        size_t skipped = std::min(skip_, length);
+        data += skipped;
+        length -= skipped;
+        skip_ -= skipped;
+    }
+    if (remaining_ >= 0) {
+        length = (size_t)std::min<long long>((long long)length, remaining_);
+        remaining_ -= (long long)length;
+    }
+
+    returned_ = true;
+    return length;
+}
+
+std::string BackupReader::tuning_report() const {
+    return tuner_ ? tuner_->report() : "";
+}
+
+CopyStreamScanner::CopyStreamScanner() {
+    reset();
+}
+
+void CopyStreamScanner::reset() {
+    state_ = HEADER;
+    pending_length_ = 0;
+    skip_ = 0;
+    fields_left_ = 0;
+}
+
+bool CopyStreamScanner::done() const {
+    return state_ == DONE;
+}
+
+size_t CopyStreamScanner::feed(const char* data, size_t length) {
+    static const char signature[11] = { 'P', 'G', 'C', 'O', 'P', 'Y', '\n', '\377', '\r', '\n', '\0' };
+    size_t pos = 0;
+
+    while (pos < length && state_ != DONE) {
+        if (state_ == EXTENSION || state_ == FIELD_DATA) {
+            size_t n = (size_t)std::min<long long>(skip_, (long long)(length - pos));
+            pos += n;
+            skip_ -= n;
+            if (skip_ == 0)
+                state_ = state_ == EXTENSION || fields_left_ == 0 ? TUPLE : FIELD_LENGTH;
+            continue;
+        }
+
+        // ,       ,     
+        size_t item = state_ == HEADER ? sizeof(pending_) : state_ == TUPLE ? 2 : 4;
+        size_t n = std::min(item - pending_length_, length - pos);
+        memcpy(pending_ + pending_length_, data + pos, n);
+        pending_length_ += n;
+        pos += n;
+        if (pending_length_ < item)
+            break;
+        pending_length_ = 0;
+
+        const unsigned char* bytes = (const unsigned char*)pending_;
+        if (state_ == HEADER) {
+            if (memcmp(pending_, signature, sizeof(signature)) != 0)
+                throw std::runtime_error("Invalid COPY BINARY header in backup file");
+            skip_ = ((long long)bytes[15] << 24) | (bytes[16] << 16) | (bytes[17] << 8) | bytes[18];
+            state_ = skip_ > 0 ? EXTENSION : TUPLE;
+        }
+        else if (state_ == TUPLE) {
+            short fields = (short)((bytes[0] << 8) | bytes[1]);
+            if (fields == -1) {
+                state_ = DONE;
+            }
+            else {
+                fields_left_ = fields;
+                state_ = fields > 0 ? FIELD_LENGTH : TUPLE;
+            }
+        }
+        else {
+            int field_length = (int)(((unsigned)bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3]);
+            fields_left_--;
+            if (field_length > 0) {
+                skip_ = field_length;
+                state_ = FIELD_DATA;
+            }
+            else {
+                state_ = fields_left_ > 0 ? FIELD_LENGTH : TUPLE;
+            }
+        }
+    }
+
+    return pos;
+}
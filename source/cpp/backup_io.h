@@ -0,0 +1,121 @@
+/*
+* ================== BACKUP_IO ==================
+*  -  ,    
+*  :
+*   - BackupWriter -     ,
+*      libpq    COPY
+*   - BackupReader -     queue_depth 
+*   - CopyStreamScanner -    COPY BINARY  
+*  Linux  io_uring (  -  )
+* ,  , O_DIRECT   .  
+*       ( "adaptive").
+*/
+
+#pragma once
+
+#ifndef BACKUP_IO_H
+#define BACKUP_IO_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include "external/json.hpp"
+#include "adaptive_tuner.h"
+
+using json = nlohmann::json;
+
+//   - ( "io" config-  )
+struct BackupIOConfig {
+    size_t buffer_size;         //   ,  ( 4096)
+    int queue_depth;            //     
+    bool direct;                // O_DIRECT -    ( Linux)
+    bool use_io_uring;          // io_uring    ( Linux)
+    bool adaptive;              //      buffer_range
+    TuningRange buffer_range;   //   ,  ( 4096)
+
+    BackupIOConfig();
+    BackupIOConfig& operator=(const json& j);
+};
+
+class AsyncFile;
+
+//   -
+struct IOBuffer {
+    std::vector<char> storage;
+    char* data;
+    size_t length;
+    bool pending;
+};
+
+class BackupWriter {
+public:
+    BackupWriter(const std::string& path, const BackupIOConfig& config);
+    ~BackupWriter();
+
+    bool is_open() const;
+    void write(const char* data, size_t length);
+    void close();
+    std::string tuning_report() const;
+
+private:
+    BackupIOConfig config_;
+    std::unique_ptr<AsyncFile> file_;
+    std::vector<IOBuffer> buffers_;
+    size_t current_;
+    long long offset_;
+    size_t block_size_;                 //  ,    
+    std::unique_ptr<AdaptiveTuner> tuner_;
+    std::chrono::steady_clock::time_point last_submit_;
+
+    void submit_current();
+};
+
+class BackupReader {
+public:
+    //  length    offset (length < 0 -   )
+    BackupReader(const std::string& path, const BackupIOConfig& config, long long offset = 0, long long length = -1);
+    ~BackupReader();
+
+    bool is_open() const;
+    size_t next(const char*& data);     // 0 -  
+    std::string tuning_report() const;
+
+private:
+    BackupIOConfig config_;
+    std::unique_ptr<AsyncFile> file_;
+    std::vector<IOBuffer> buffers_;
+    size_t current_;
+    long long offset_;
+    bool returned_;
+    bool eof_;
+    size_t skip_;                       //     offset ( )
+    long long end_;                     //    (-1 -  )
+    long long remaining_;               //  ,    (-1 -  )
+    size_t block_size_;                 //    
+    std::unique_ptr<AdaptiveTuner> tuner_;
+    std::chrono::steady_clock::time_point last_next_;
+
+    void submit(size_t slot);
+};
+
+//    COPY BINARY   
+class CopyStreamScanner {
+public:
+    CopyStreamScanner();
+
+    void reset();
+    size_t feed(const char* data, size_t length);   //  ,    
+    bool done() const;
+
+private:
+    enum State { HEADER, EXTENSION, TUPLE, FIELD_LENGTH, FIELD_DATA, DONE };
+
+    State state_;
+    char pending_[19];
+    size_t pending_length_;
+    long long skip_;
+    int fields_left_;
+};
+
+#endif // BACKUP_IO_H
@@ -0,0 +1,486 @@
+#include "chunk_store.h"
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <openssl/evp.h>
+
+namespace fs = std::filesystem;
+
+//    Gear;   -  
+//       
+struct GearTable {
+    uint64_t values[256];
+
+    GearTable() {
+        uint64_t state = 0x243F6A8885A308D3ULL;
+        for (int i = 0; i < 256; i++) {
+            // splitmix64
+            uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            values[i] = z ^ (z >> 31);
+        }
+    }
+};
+
+static const GearTable GEAR;
+
+// SHA-256      (libcrypto,    libpq)
+std::string sha256_hex(const char* data, size_t length) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    if (EVP_Digest(data, length, digest, &digest_length, EVP_sha256(), nullptr) != 1)
+        throw std::runtime_error("Failed to compute SHA-256 of a chunk");
+
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(digest_length * 2);
+    for (unsigned int i = 0; i < digest_length; i++) {
+        hex += digits[digest[i] >> 4];
+        hex += digits[digest[i] & 0x0F];
+    }
+    return hex;
+}
+
+ChunkStoreConfig::ChunkStoreConfig()
+    : min_chunk(256 * 1024), avg_chunk(1024 * 1024), max_chunk(4 * 1024 * 1024), threads(4), prune(false) {
+}
+
+ChunkStoreConfig& ChunkStoreConfig::operator=(const json& j) {
+    if (j.is_string()) {
+        path = j.get<std::string>();
+        return *this;
+    }
+    if (!j.is_object() || !j.contains("path"))
+        throw std::domain_error("Backup repository must be a path or an object with path");
+
+    path = j["path"].get<std::string>();
+    min_chunk = j.value("min_chunk", (size_t)256 * 1024);
+    avg_chunk = j.value("avg_chunk", (size_t)1024 * 1024);
+    max_chunk = j.value("max_chunk", (size_t)4 * 1024 * 1024);
+    threads = j.value("threads", 4);
+    prune = j.value("prune", false);
+    keep.clear();
+    if (j.contains("keep")) {
+        for (const auto& manifest : j["keep"])
+            keep.push_back(manifest.get<std::string>());
+    }
+
+    if (path.empty() || min_chunk == 0 || avg_chunk <= min_chunk || max_chunk < avg_chunk || threads < 1)
+        throw std::domain_error("Backup repository requires path, 0 < min_chunk < avg_chunk <= max_chunk and threads >= 1");
+
+    return *this;
+}
+
+bool ChunkStoreConfig::enabled() const {
+    return !path.empty();
+}
+
+BackupManifest::BackupManifest()
+    : format("chunks") {
+}
+
+//     COPY BINARY    "PGCOPY",  -  json-
+bool BackupManifest::is_manifest(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char c;
+    while (file.get(c)) {
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+            return c == '{';
+    }
+    return false;
+}
+
+void BackupManifest::load(const std::string& path) {
+    std::ifstream manifest_file(path);
+    if (!manifest_file.is_open())
+        throw std::runtime_error("Failed to open backup manifest: " + path);
+
+    json j;
+    manifest_file >> j;
+
+    format = j.value("format", "chunks");
+    repository = j.value("repository", "");
+    file = j.value("file", "");
+    if (format != "chunks" && format != "file")
+        throw std::runtime_error("Unknown backup manifest format: " + format);
+
+    tables.clear();
+    for (const auto& table_json : j.at("tables")) {
+        ManifestTable table;
+        table.name = table_json.at("name").get<std::string>();
+        table.offset = table_json.value("offset", 0LL);
+        table.size = table_json.at("size").get<long long>();
+        if (table_json.contains("columns")) {
+            for (const auto& column : table_json["columns"])
+                table.columns.push_back({ column.at(0).get<std::string>(), column.at(1).get<std::string>() });
+        }
+        if (table_json.contains("chunks")) {
+            for (const auto& chunk : table_json["chunks"])
+                table.chunks.push_back({ chunk.at(0).get<std::string>(), chunk.at(1).get<size_t>() });
+        }
+        tables.push_back(table);
+    }
+}
+
+//         
+void BackupManifest::save(const std::string& path) const {
+    json j;
+    j["format"] = format;
+    if (format == "chunks")
+        j["repository"] = repository;
+    else
+        j["file"] = file;
+    j["tables"] = json::array();
+    for (const auto& table : tables) {
+        json columns = json::array();
+        for (const auto& column : table.columns)
+            columns.push_back(json::array({ column.name, column.type }));
+
+        json table_json = { { "name", table.name }, { "size", table.size }, { "columns", columns } };
+        if (format == "chunks") {
+            json chunks = json::array();
+            for (const auto& chunk : table.chunks)
+                chunks.push_back(json::array({ chunk.hash, chunk.size }));
+            table_json["chunks"] = chunks;
+        }
+        else {
+            table_json["offset"] = table.offset;
+        }
+        j["tables"].push_back(table_json);
+    }
+
+    std::string temp = path + ".tmp";
+    std::ofstream manifest_file(temp, std::ios::trunc);
+    manifest_file << j.dump();
+    manifest_file.close();
+    if (!manifest_file)
+        throw std::runtime_error("Failed to write backup manifest: " + temp);
+
+    std::error_code ec;
+    fs::rename(temp, path, ec);
+    if (ec)
+        throw std::runtime_error("Failed to write backup manifest " + path + ": " + ec.message());
+}
+
+const ManifestTable* BackupManifest::find(const std::string& table) const {
+    for (const auto& manifest_table : tables) {
+        if (manifest_table.name == table)
+            return &manifest_table;
+    }
+    return nullptr;
+}
+
+ChunkStore::ChunkStore(const std::string& path)
+    : path_(path) {
+}
+
+//         
+std::string ChunkStore::chunk_path(const std::string& hash) const {
+    return (fs::path(path_) / hash.substr(0, 2) / hash).string();
+}
+
+//       :  
+//           
+bool ChunkStore::put(const std::string& hash, const char* data, size_t length) {
+    std::string path = chunk_path(hash);
+    std::error_code ec;
+    if (fs::exists(path, ec))
+        return false;
+
+    fs::create_directories(fs::path(path).parent_path(), ec);
+    if (ec)
+        throw std::runtime_error("Failed to create chunk directory: " + ec.message());
+
+    std::string temp = path + ".tmp" +
+        std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+            (size_t)std::chrono::steady_clock::now().time_since_epoch().count());
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    file.write(data, (std::streamsize)length);
+    file.close();
+    if (!file) {
+        fs::remove(temp, ec);
+        throw std::runtime_error("Failed to write chunk " + hash);
+    }
+
+    fs::rename(temp, path, ec);
+    if (ec) {
+        fs::remove(temp, ec);
+        if (!fs::exists(path, ec))
+            throw std::runtime_error("Failed to store chunk " + hash);
+        return false;
+    }
+    return true;
+}
+
+void ChunkStore::get(const ChunkRef& chunk, std::vector<char>& data) const {
+    std::ifstream file(chunk_path(chunk.hash), std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Chunk " + chunk.hash + " is missing from the repository");
+
+    data.resize(chunk.size);
+    file.read(data.data(), (std::streamsize)chunk.size);
+    if ((size_t)file.gcount() != chunk.size || file.peek() != std::ifstream::traits_type::eof() ||
+        sha256_hex(data.data(), data.size()) != chunk.hash)
+        throw std::runtime_error("Chunk " + chunk.hash + " is corrupted");
+}
+
+//     (".tmp...")     
+long long ChunkStore::prune(const std::unordered_set<std::string>& referenced, long long& removed_bytes) {
+    long long removed = 0;
+    removed_bytes = 0;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(path_, ec), end; !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec))
+            continue;
+
+        std::string name = it->path().filename().string();
+        if (name.size() != 64 || name.find_first_not_of("0123456789abcdef") != std::string::npos ||
+            referenced.count(name))
+            continue;
+
+        std::error_code size_ec;
+        uintmax_t size = it->file_size(size_ec);
+        if (size_ec)
+            size = 0;
+        if (fs::remove(it->path(), ec)) {
+            removed++;
+            removed_bytes += (long long)size;
+        }
+    }
+    if (ec)
+        throw std::runtime_error("Failed to prune backup repository " + path_ + ": " + ec.message());
+    return removed;
+}
+
+ChunkSplitter::ChunkSplitter(ChunkStore& store, const ChunkStoreConfig& config)
+    : store_(store), config_(config), hash_(0), active_(0), stop_(false),
+      total_bytes_(0), stored_bytes_(0), total_chunks_(0), stored_chunks_(0) {
+    //     2^-bits    min_chunk
+    int bits = (int)std::lround(std::log2((double)(config_.avg_chunk - config_.min_chunk)));
+    shift_ = 64 - std::min(std::max(bits, 1), 63);
+
+    pending_.reserve(config_.max_chunk);
+    for (int i = 0; i < config_.threads; i++)
+        workers_.emplace_back(&ChunkSplitter::work, this);
+}
+
+ChunkSplitter::~ChunkSplitter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    changed_.notify_all();
+    for (auto& worker : workers_)
+        worker.join();
+}
+
+void ChunkSplitter::begin(const std::string& table) {
+    table_ = ManifestTable();
+    table_.name = table;
+    table_.offset = 0;
+    table_.size = 0;
+    pending_.clear();
+    hash_ = 0;
+}
+
+void ChunkSplitter::write(const char* data, size_t length) {
+    const unsigned char* in = (const unsigned char*)data;
+    size_t start = 0;
+    table_.size += (long long)length;
+
+    for (size_t pos = 0; pos < length; pos++) {
+        size_t size = pending_.size() + (pos - start) + 1;
+        if (size <= config_.min_chunk)
+            continue;
+
+        hash_ = (hash_ << 1) + GEAR.values[in[pos]];
+        if ((hash_ >> shift_) == 0 || size >= config_.max_chunk) {
+            pending_.insert(pending_.end(), data + start, data + pos + 1);
+            start = pos + 1;
+            cut();
+        }
+    }
+    pending_.insert(pending_.end(), data + start, data + length);
+}
+
+//      ;  ,
+//        
+void ChunkSplitter::cut() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&] { return !error_.empty() || tasks_.size() < (size_t)config_.threads * 2; });
+    if (!error_.empty())
+        throw std::runtime_error(error_);
+
+    Task task;
+    task.index = table_.chunks.size();
+    task.data.swap(pending_);
+    table_.chunks.push_back({ "", task.data.size() });
+    tasks_.push_back(std::move(task));
+    lock.unlock();
+    changed_.notify_all();
+
+    pending_.reserve(config_.max_chunk);
+    hash_ = 0;
+}
+
+void ChunkSplitter::wait_idle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&] { return tasks_.empty() && active_ == 0; });
+    if (!error_.empty())
+        throw std::runtime_error(error_);
+}
+
+ManifestTable ChunkSplitter::end() {
+    if (!pending_.empty())
+        cut();
+    wait_idle();
+
+    total_bytes_ += table_.size;
+    total_chunks_ += (long long)table_.chunks.size();
+    return table_;
+}
+
+long long ChunkSplitter::total_bytes() const {
+    return total_bytes_;
+}
+
+long long ChunkSplitter::stored_bytes() const {
+    return stored_bytes_;
+}
+
+long long ChunkSplitter::total_chunks() const {
+    return total_chunks_;
+}
+
+long long ChunkSplitter::stored_chunks() const {
+    return stored_chunks_;
+}
+
+void ChunkSplitter::work() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [&] { return stop_ || !tasks_.empty(); });
+            if (stop_)
+                return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+            active_++;
+        }
+        changed_.notify_all();
+
+        std::string hash;
+        std::string error;
+        bool stored = false;
+        try {
+            hash = sha256_hex(task.data.data(), task.data.size());
+            stored = store_.put(hash, task.data.data(), task.data.size());
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            active_--;
+            if (error.empty()) {
+                table_.chunks[task.index].hash = hash;
+                if (stored) {
+                    stored_chunks_++;
+                    stored_bytes_ += (long long)task.data.size();
+                }
+            }
+            else if (error_.empty()) {
+                error_ = error;
+            }
+        }
+        changed_.notify_all();
+    }
+}
+
+ChunkStreamReader::ChunkStreamReader(const ChunkStore& store, const std::vector<ChunkRef>& chunks, int threads)
+    : store_(store), chunks_(chunks), slots_((size_t)std::max(1, threads) * 2),
+      fetched_(0), current_(0), returned_(false), stop_(false) {
+    for (auto& slot : slots_)
+        slot.ready = false;
+
+    int workers = (int)std::min<size_t>((size_t)std::max(1, threads), chunks_.size());
+    for (int i = 0; i < workers; i++)
+        workers_.emplace_back(&ChunkStreamReader::work, this);
+}
+
+ChunkStreamReader::~ChunkStreamReader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    changed_.notify_all();
+    for (auto& worker : workers_)
+        worker.join();
+}
+
+//      
+size_t ChunkStreamReader::next(const char*& data) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (returned_) {
+        slots_[current_ % slots_.size()].ready = false;
+        current_++;
+        returned_ = false;
+        changed_.notify_all();
+    }
+    if (current_ >= chunks_.size())
+        return 0;
+
+    Slot& slot = slots_[current_ % slots_.size()];
+    changed_.wait(lock, [&] { return slot.ready || !error_.empty(); });
+    if (!slot.ready)
+        throw std::runtime_error(error_);
+
+    data = slot.data.data();
+    returned_ = true;
+    return slot.data.size();
+}
+
+void ChunkStreamReader::work() {
+    std::vector<char> data;
+    while (true) {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [&] {
+                return stop_ || fetched_ >= chunks_.size() || fetched_ < current_ + slots_.size();
+            });
+            if (stop_ || fetched_ >= chunks_.size())
+                return;
+            index = fetched_++;
+        }
+
+        std::string error;
+        try {
+            store_.get(chunks_[index], data);
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (error.empty()) {
+                Slot& slot = slots_[index % slots_.size()];
+                slot.data.swap(data);
+                slot.ready = true;
+            }
+            else if (error_.empty()) {
+                error_ = error;
+            }
+        }
+        changed_.notify_all();
+    }
+}
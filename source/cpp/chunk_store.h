@@ -0,0 +1,179 @@
+/*
+* ================== CHUNK_STORE ==================
+*     :
+*   - ChunkStore -  :    
+*        ,   - SHA-256  . 
+*      ,       (prune): 
+*              keep
+*   - ChunkSplitter -   COPY    
+*      (  Gear).   
+*        ,    
+*           
+*   - BackupManifest -     json- 
+*             ( 
+*        -  "<>.manifest"   )
+*   - ChunkStreamReader -     , 
+*           
+*/
+
+#pragma once
+
+#ifndef CHUNK_STORE_H
+#define CHUNK_STORE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <unordered_set>
+#include "external/json.hpp"
+
+using json = nlohmann::json;
+
+//   ( "repository" config-  )
+struct ChunkStoreConfig {
+    std::string path;           //  
+    size_t min_chunk;           //  , :   
+    size_t avg_chunk;           //   avg_chunk    
+    size_t max_chunk;           //  [min_chunk, max_chunk]
+    int threads;                //    / 
+    bool prune;                 //    ,       keep
+    std::vector<std::string> keep;  // -  
+
+    ChunkStoreConfig();
+    ChunkStoreConfig& operator=(const json& j);
+    bool enabled() const;
+};
+
+struct ChunkRef {
+    std::string hash;
+    size_t size;
+};
+
+struct ManifestColumn {
+    std::string name;
+    std::string type;           //    format_type()
+};
+
+struct ManifestTable {
+    std::string name;
+    long long offset;           //   COPY     ( "file")
+    long long size;             //   COPY , 
+    std::vector<ManifestColumn> columns;
+    std::vector<ChunkRef> chunks;
+};
+
+class BackupManifest {
+public:
+    std::string format;         // "chunks" -   , "file" -  COPY   
+    std::string repository;     //      
+    std::string file;           //   COPY ( "file")
+    std::vector<ManifestTable> tables;
+
+    BackupManifest();
+
+    static bool is_manifest(const std::string& path);     //  -   COPY BINARY
+    void load(const std::string& path);
+    void save(const std::string& path) const;
+    const ManifestTable* find(const std::string& table) const;
+};
+
+// SHA-256    -    
+std::string sha256_hex(const char* data, size_t length);
+
+//        
+class ChunkStore {
+public:
+    explicit ChunkStore(const std::string& path);
+
+    bool put(const std::string& hash, const char* data, size_t length);     // false -   
+    void get(const ChunkRef& chunk, std::vector<char>& data) const;         //   
+
+    //  ,    referenced;    .
+    //            
+    long long prune(const std::unordered_set<std::string>& referenced, long long& removed_bytes);
+
+private:
+    std::string path_;
+
+    std::string chunk_path(const std::string& hash) const;
+};
+
+class ChunkSplitter {
+public:
+    ChunkSplitter(ChunkStore& store, const ChunkStoreConfig& config);
+    ~ChunkSplitter();
+
+    void begin(const std::string& table);
+    void write(const char* data, size_t length);
+    ManifestTable end();
+
+    long long total_bytes() const;
+    long long stored_bytes() const;     //   ,   
+    long long total_chunks() const;
+    long long stored_chunks() const;
+
+private:
+    struct Task {
+        size_t index;
+        std::vector<char> data;
+    };
+
+    ChunkStore& store_;
+    ChunkStoreConfig config_;
+    int shift_;                         //   -     
+    uint64_t hash_;
+    std::vector<char> pending_;
+    ManifestTable table_;
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<Task> tasks_;
+    size_t active_;
+    bool stop_;
+    std::string error_;
+
+    long long total_bytes_;
+    long long stored_bytes_;
+    long long total_chunks_;
+    long long stored_chunks_;
+
+    void cut();
+    void wait_idle();
+    void work();
+};
+
+class ChunkStreamReader {
+public:
+    ChunkStreamReader(const ChunkStore& store, const std::vector<ChunkRef>& chunks, int threads);
+    ~ChunkStreamReader();
+
+    size_t next(const char*& data);     // 0 -  
+
+private:
+    struct Slot {
+        std::vector<char> data;
+        bool ready;
+    };
+
+    const ChunkStore& store_;
+    std::vector<ChunkRef> chunks_;
+    std::vector<Slot> slots_;           //  :  index   slots_[index % size]
+    size_t fetched_;                    //    
+    size_t current_;                    //    
+    bool returned_;
+    bool stop_;
+    std::string error_;
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+
+    void work();
+};
+
+#endif // CHUNK_STORE_H
@@ -2,8 +2,27 @@
 #include "database_migrator.h"
 #include <sstream>
 #include <iomanip>
+#include <deque>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdlib>
+#include <charconv>
+#include "table_writer.h"
+#include "large_value.h"
+#include "chunk_store.h"
+#include <libpq/libpq-fs.h>
 #include "external/base64.hpp"
 
+// OID   :      
+static const Oid FIRST_NORMAL_OID = 16384;
+//        
+static const std::string BACKUP_SCHEMA = "migrator_backup";
+//        
+static const int BACKUP_CHUNK_THREADS = 2;
+
 ProgressCallback DatabaseMigrator::callback_ = nullptr;
 
 DatabaseConfig& DatabaseConfig::operator=(const json& j) {
@@ -30,6 +49,280 @@ DatabaseConfig& DatabaseConfig::operator=(const json& j) {
     }
 }
 
+BulkLoadConfig::BulkLoadConfig()
+    : enabled(false), commit_rows(0), commit_bytes(0),
+      staging(false), disable_triggers(false), synchronous_commit(true) {
+}
+
+BulkLoadConfig& BulkLoadConfig::operator=(const json& j) {
+    if (!j.is_object())
+        throw std::domain_error("Table bulk_load must be an object (json id=302)");
+
+    enabled = j.value("enabled", true);
+    commit_rows = j.value("commit_rows", 0LL);
+    commit_bytes = j.value("commit_bytes", 0LL);
+    staging = j.value("staging", false);
+    disable_triggers = j.value("disable_triggers", false);
+    synchronous_commit = j.value("synchronous_commit", false);
+
+    if (commit_rows < 0 || commit_bytes < 0)
+        throw std::domain_error("Table bulk_load commit interval must not be negative (json id=302)");
+
+    return *this;
+}
+
+bool BulkLoadConfig::commit_due(long long rows, long long bytes) const {
+    return (commit_rows > 0 && rows >= commit_rows) ||
+        (commit_bytes > 0 && bytes >= commit_bytes);
+}
+
+UpsertConfig::UpsertConfig()
+    : enabled(false), update(true), batch_rows(500), pipeline_depth(4) {
+}
+
+UpsertConfig& UpsertConfig::operator=(const json& j) {
+    if (!j.is_object())
+        throw std::domain_error("Table upsert must be an object (json id=302)");
+
+    enabled = j.value("enabled", true);
+    batch_rows = j.value("batch_rows", 500);
+    pipeline_depth = j.value("pipeline_depth", 4);
+
+    std::string on_conflict = j.value("on_conflict", "update");
+    if (on_conflict != "update" && on_conflict != "nothing")
+        throw std::domain_error("Table upsert on_conflict must be 'update' or 'nothing' (json id=302)");
+    update = on_conflict == "update";
+
+    conflict_key.clear();
+    if (j.contains("conflict_key")) {
+        const json& key_json = j["conflict_key"];
+        if (key_json.is_string())
+            conflict_key.push_back(key_json.get<std::string>());
+        else
+            conflict_key = key_json.get<std::vector<std::string>>();
+    }
+
+    if (update && conflict_key.empty())
+        throw std::domain_error("Table upsert with on_conflict 'update' requires conflict_key (json id=302)");
+    if (batch_rows < 1 || pipeline_depth < 1)
+        throw std::domain_error("Table upsert batch_rows and pipeline_depth must be positive (json id=302)");
+
+    return *this;
+}
+
+PipelineConfig::PipelineConfig()
+    : fetch_rows(1000), memory_limit(64LL * 1024 * 1024), target_buffer(16) {
+}
+
+PipelineConfig& PipelineConfig::operator=(const json& j) {
+    if (!j.is_object())
+        throw std::domain_error("Pipeline configuration must be an object (json id=302)");
+
+    fetch_rows = j.value("fetch_rows", 1000);
+    memory_limit = j.value("memory_limit", 64LL * 1024 * 1024);
+    target_buffer = j.value("target_buffer", 16);
+
+    if (fetch_rows < 1 || memory_limit < 1 || target_buffer < 1)
+        throw std::domain_error("Pipeline fetch_rows, memory_limit and target_buffer must be positive (json id=302)");
+
+    return *this;
+}
+
+TuningConfig::TuningConfig()
+    : enabled(false), fetch_rows(100, 100000), commit_rows(1000, 1000000), copy_buffer(64 * 1024, 16 * 1024 * 1024),
+      window(4) {
+}
+
+TuningConfig& TuningConfig::operator=(const json& j) {
+    if (!j.is_object())
+        throw std::domain_error("Tuning configuration must be an object (json id=302)");
+
+    enabled = j.value("enabled", true);
+    window = j.value("window", 4);
+    if (j.contains("fetch_rows"))
+        fetch_rows = j["fetch_rows"];
+    if (j.contains("commit_rows"))
+        commit_rows = j["commit_rows"];
+    if (j.contains("copy_buffer"))
+        copy_buffer = j["copy_buffer"];
+
+    if (window < 1)
+        throw std::domain_error("Tuning window must be positive (json id=302)");
+
+    return *this;
+}
+
+VerifyConfig::VerifyConfig()
+    : chunks(16), min_chunk_rows(1000), parallel(4) {
+}
+
+VerifyConfig& VerifyConfig::operator=(const json& j) {
+    if (!j.is_object())
+        throw std::domain_error("Table verify must be an object (json id=302)");
+
+    key = j.value("key", "");
+    chunks = j.value("chunks", 16);
+    min_chunk_rows = j.value("min_chunk_rows", 1000LL);
+    parallel = j.value("parallel", 4);
+
+    if (chunks < 2 || min_chunk_rows < 1 || parallel < 1)
+        throw std::domain_error("Table verify chunks must be at least 2, min_chunk_rows and parallel positive (json id=302)");
+
+    return *this;
+}
+
+ShardConfig::ShardConfig()
+    : range(false) {
+}
+
+ShardConfig& ShardConfig::operator=(const json& j) {
+    if (!j.is_object())
+        throw std::domain_error("Table shard must be an object (json id=302)");
+
+    key = j.value("key", "");
+    targets = j.value("targets", std::vector<std::string>());
+    bounds = j.value("bounds", std::vector<long long>());
+
+    std::string method = j.value("method", "hash");
+    if (method != "hash" && method != "range")
+        throw std::domain_error("Table shard method must be 'hash' or 'range' (json id=302)");
+    range = method == "range";
+
+    if (key.empty() || targets.size() < 2)
+        throw std::domain_error("Table shard requires key and at least two targets (json id=302)");
+    if (range && bounds.size() != targets.size() - 1)
+        throw std::domain_error("Table shard with method 'range' requires one bound less than targets (json id=302)");
+    if (!std::is_sorted(bounds.begin(), bounds.end()) ||
+        std::adjacent_find(bounds.begin(), bounds.end()) != bounds.end())
+        throw std::domain_error("Table shard bounds must be strictly ascending (json id=302)");
+
+    return *this;
+}
+
+bool ShardConfig::enabled() const {
+    return !targets.empty();
+}
+
+//      ; NULL    .
+//    ,     
+int ShardConfig::route(const char* value, int length) const {
+    if (!value)
+        return 0;
+
+    if (!range) {
+        // FNV-1a
+        unsigned long long hash = 14695981039346656037ULL;
+        for (int i = 0; i < length; i++) {
+            hash ^= (unsigned char)value[i];
+            hash *= 1099511628211ULL;
+        }
+        return (int)(hash % targets.size());
+    }
+
+    // from_chars   '+',   '+' 
+    const char* begin = value;
+    const char* end = value + length;
+    if (begin != end && *begin == '+' && end - begin > 1 && begin[1] != '-')
+        begin++;
+
+    long long number = 0;
+    std::from_chars_result parsed = std::from_chars(begin, end, number);
+    if (parsed.ec == std::errc::result_out_of_range)
+        throw std::runtime_error("Shard key value is out of range");
+    if (parsed.ec != std::errc() || parsed.ptr != end)
+        throw std::runtime_error("Shard key value isn't an integer");
+
+    return (int)(std::upper_bound(bounds.begin(), bounds.end(), number) - bounds.begin());
+}
+
+//   :  bytea/text     1 
+static const long long MAX_CHUNK_SIZE = 1LL << 30;
+
+LargeValueConfig::LargeValueConfig()
+    : threshold(16LL * 1024 * 1024), chunk_size(1024 * 1024) {
+}
+
+LargeValueConfig& LargeValueConfig::operator=(const json& j) {
+    if (!j.is_object())
+        throw std::domain_error("Table large_values must be an object (json id=302)");
+
+    columns = j.value("columns", std::vector<std::string>());
+    threshold = j.value("threshold", 16LL * 1024 * 1024);
+    chunk_size = j.value("chunk_size", 1024LL * 1024);
+
+    key.clear();
+    if (j.contains("key")) {
+        const json& key_json = j["key"];
+        if (key_json.is_string())
+            key.push_back(key_json.get<std::string>());
+        else
+            key = key_json.get<std::vector<std::string>>();
+    }
+
+    if (columns.empty() || key.empty())
+        throw std::domain_error("Table large_values requires columns and key (json id=302)");
+    if (threshold < 0 || chunk_size < 1 || chunk_size > MAX_CHUNK_SIZE)
+        throw std::domain_error("Table large_values threshold must not be negative, chunk_size must be from 1 to 1 GB (json id=302)");
+
+    return *this;
+}
+
+bool LargeValueConfig::enabled() const {
+    return !columns.empty();
+}
+
+LargeObjectConfig::LargeObjectConfig()
+    : enabled(false), chunk_size(1024 * 1024) {
+}
+
+LargeObjectConfig& LargeObjectConfig::operator=(const json& j) {
+    if (j.is_boolean()) {
+        enabled = j.get<bool>();
+        return *this;
+    }
+    if (!j.is_object())
+        throw std::domain_error("Large objects configuration must be an object or boolean (json id=302)");
+
+    enabled = j.value("enabled", true);
+    chunk_size = j.value("chunk_size", 1024LL * 1024);
+
+    if (chunk_size < 1 || chunk_size > MAX_CHUNK_SIZE)
+        throw std::domain_error("Large objects chunk_size must be from 1 to 1 GB (json id=302)");
+
+    return *this;
+}
+
+OffloadConfig::OffloadConfig()
+    : enabled(false), detect(true), schema("migrator_offload") {
+}
+
+OffloadConfig& OffloadConfig::operator=(const json& j) {
+    if (j.is_boolean()) {
+        // false     
+        enabled = j.get<bool>();
+        detect = enabled;
+        return *this;
+    }
+    if (!j.is_object())
+        throw std::domain_error("Target database offload must be an object or boolean (json id=302)");
+
+    enabled = j.value("enabled", true);
+    detect = j.value("detect", true);
+    link = j.value("link", "");
+    server = j.value("server", "");
+    schema = j.value("schema", "migrator_offload");
+
+    if (!link.empty() && link != "postgres_fdw" && link != "dblink")
+        throw std::domain_error("Target database offload link must be postgres_fdw or dblink (json id=302)");
+    if (link == "postgres_fdw" && (server.empty() || schema.empty()))
+        throw std::domain_error("Target database offload through postgres_fdw requires server and schema (json id=302)");
+    //             (pg_stat_activity, )
+    if (link == "dblink" && server.empty())
+        throw std::domain_error("Target database offload through dblink requires server (json id=302)");
+
+    return *this;
+}
+
 TableConfig::TableConfig(const json& j) {
     *this = j;
 }
@@ -42,12 +335,39 @@ TableConfig& TableConfig::operator=(const json& j) {
             throw std::invalid_argument("Missing required field 'source' in table configuration (json id=302)");
 
         source = j["source"].get<std::string>();
+        relation.clear();
         target = j.value("target", "");
         exclude = j.value("exclude", false);
         create_if_missing = j.value("create_if_missing", false);
+        where = j.value("where", "");
+        pushdown = j.value("pushdown", true);
 
         columns.clear();
 
+        bulk_load = BulkLoadConfig();
+        if (j.contains("bulk_load"))
+            bulk_load = j["bulk_load"];
+
+        verify = VerifyConfig();
+        if (j.contains("verify"))
+            verify = j["verify"];
+
+        upsert = UpsertConfig();
+        if (j.contains("upsert"))
+            upsert = j["upsert"];
+
+        shard = ShardConfig();
+        if (j.contains("shard"))
+            shard = j["shard"];
+
+        large_values = LargeValueConfig();
+        if (j.contains("large_values"))
+            large_values = j["large_values"];
+
+        //        -     
+        if (upsert.enabled && bulk_load.enabled && bulk_load.staging)
+            throw std::domain_error("Table upsert can't be combined with bulk_load staging (json id=302)");
+
         //   
         if (j.contains("columns")) {
             const json& columns_json = j["columns"];
@@ -61,13 +381,26 @@ TableConfig& TableConfig::operator=(const json& j) {
                     column["target_name"] = column_config["target_name"].get<std::string>();
                 if (column_config.contains("type"))
                     column["type"] = column_config["type"].get<std::string>();
-                if (column_config.contains("exclude"))
-                    column["exclude"] = column_config["exclude"].get<std::string>();
+                if (column_config.contains("exclude")) {
+                    const json& exclude_json = column_config["exclude"];
+                    column["exclude"] = exclude_json.is_boolean() ?
+                        (exclude_json.get<bool>() ? "true" : "false") : exclude_json.get<std::string>();
+                }
 
                 columns[column_name] = column;
             }
         }
 
+        //           
+        for (const auto& column_name : large_values.columns) {
+            auto column = columns.find(column_name);
+            if (column == columns.end() || (column->second.count("exclude") && column->second.at("exclude") == "true"))
+                throw std::domain_error("Large value column " + column_name + " must be a migrated column (json id=302)");
+        }
+        //  DO NOTHING        
+        if (large_values.enabled() && upsert.enabled && !upsert.update)
+            throw std::domain_error("Table large_values can't be combined with upsert on_conflict 'nothing' (json id=302)");
+
         return *this;
     }
     catch (const std::invalid_argument& e) {
@@ -82,6 +415,122 @@ TableConfig& TableConfig::operator=(const json& j) {
     }
 }
 
+std::string TableConfig::source_relation() const {
+    return relation.empty() ? source : relation;
+}
+
+BackupSourceConfig::BackupSourceConfig()
+    : threads(4) {
+}
+
+BackupSourceConfig& BackupSourceConfig::operator=(const json& j) {
+    if (j.is_string()) {
+        file = j.get<std::string>();
+        return *this;
+    }
+    if (!j.is_object() || !j.contains("file"))
+        throw std::domain_error("Source backup must be a file path or an object with file (json id=302)");
+
+    file = j["file"].get<std::string>();
+    repository = j.value("repository", "");
+    staging = j.value("staging", "");
+    threads = j.value("threads", 4);
+
+    io = BackupIOConfig();
+    if (j.contains("io"))
+        io = j["io"];
+
+    if (file.empty() || threads < 1)
+        throw std::domain_error("Source backup requires file and threads >= 1 (json id=302)");
+
+    return *this;
+}
+
+bool BackupSourceConfig::enabled() const {
+    return !file.empty();
+}
+
+TargetConfig& TargetConfig::operator=(const json& j) {
+    try {
+        database = j;
+        name = j.value("name", database.dbname);
+
+        offload = OffloadConfig();
+        if (j.contains("offload"))
+            offload = j["offload"];
+
+        tables.clear();
+        if (j.contains("tables")) {
+            const json& tables_json = j["tables"];
+            if (!tables_json.is_object())
+                throw std::domain_error("Target database tables must be an object (json id=302)");
+
+            for (const auto& [table_name, table_json] : tables_json.items()) {
+                if (!table_json.is_object())
+                    throw std::domain_error("Target database table " + table_name + " must be an object (json id=302)");
+                tables[table_name] = table_json;
+            }
+        }
+
+        return *this;
+    }
+    catch (const std::domain_error& e) {
+        Logger::log(Logger::ERROR, "TargetConfig",
+            "Error in target database configuration: " + std::string(e.what()));
+        throw;
+    }
+}
+
+//     :      ,
+//    , bulk_load  upsert.     
+//    -      
+TableConfig TargetConfig::resolve(const TableConfig& table_config) const {
+    TableConfig resolved = table_config;
+    auto table = tables.find(table_config.source);
+    if (table == tables.end())
+        return resolved;
+
+    const json& j = table->second;
+    resolved.target = j.value("target", resolved.target);
+    resolved.exclude = j.value("exclude", resolved.exclude);
+    resolved.create_if_missing = j.value("create_if_missing", resolved.create_if_missing);
+
+    if (j.contains("bulk_load"))
+        resolved.bulk_load = j["bulk_load"];
+    if (j.contains("upsert"))
+        resolved.upsert = j["upsert"];
+
+    if (resolved.upsert.enabled && resolved.bulk_load.enabled && resolved.bulk_load.staging)
+        throw std::domain_error("Table upsert can't be combined with bulk_load staging (json id=302)");
+    if (resolved.large_values.enabled() && resolved.upsert.enabled && !resolved.upsert.update)
+        throw std::domain_error("Table large_values can't be combined with upsert on_conflict 'nothing' (json id=302)");
+
+    if (j.contains("columns")) {
+        const json& columns_json = j["columns"];
+        if (!columns_json.is_object())
+            throw std::domain_error("Table columns must be an object (json id=302)");
+
+        for (const auto& [column_name, column_config] : columns_json.items()) {
+            auto column = resolved.columns.find(column_name);
+            if (column == resolved.columns.end())
+                throw std::domain_error("Column " + column_name + " of table " + table_config.source +
+                    " isn't described in the table configuration (json id=302)");
+            if (column_config.contains("type"))
+                throw std::domain_error("Column type can't be overridden for a target database (json id=302)");
+
+            if (column_config.contains("target_name"))
+                column->second["target_name"] = column_config["target_name"].get<std::string>();
+            if (column_config.contains("exclude")) {
+                const json& exclude_json = column_config["exclude"];
+                column->second["exclude"] = exclude_json.is_boolean() ?
+                    (exclude_json.get<bool>() ? "true" : "false") : exclude_json.get<std::string>();
+            }
+        }
+    }
+
+    return resolved;
+}
+
 DatabaseMigrator::DatabaseMigrator(std::string config_path)
     : config_path(config_path) {
     load_config();
@@ -97,8 +546,50 @@ void DatabaseMigrator::load_config() {
         json config;
         config_file >> config;
 
-        source_db = config["source_database"];
-        target_db = config["target_database"];
+        source_backup = BackupSourceConfig();
+        if (config.contains("source_backup"))
+            source_backup = config["source_backup"];
+        else
+            source_db = config["source_database"];
+
+        //      ,       
+        const json& targets_json = config["target_database"];
+        std::vector<json> target_list = targets_json.is_array() ?
+            targets_json.get<std::vector<json>>() : std::vector<json>{ targets_json };
+        targets.clear();
+        for (const json& target_json : target_list) {
+            TargetConfig target;
+            target = target_json;
+            targets.push_back(target);
+        }
+
+        if (targets.empty())
+            throw std::invalid_argument("At least one target database is required (json id=302)");
+
+        //      ;        
+        if (source_backup.enabled()) {
+            size_t staging = 0;
+            if (!source_backup.staging.empty()) {
+                while (staging < targets.size() && targets[staging].name != source_backup.staging)
+                    staging++;
+                if (staging == targets.size())
+                    throw std::domain_error("Source backup staging " + source_backup.staging +
+                        " isn't a target database (json id=302)");
+            }
+            source_db = targets[staging].database;
+        }
+
+        pipeline = PipelineConfig();
+        if (config.contains("pipeline"))
+            pipeline = config["pipeline"];
+
+        large_objects = LargeObjectConfig();
+        if (config.contains("large_objects"))
+            large_objects = config["large_objects"];
+
+        tuning = TuningConfig();
+        if (config.contains("tuning"))
+            tuning = config["tuning"];
 
         if (config.contains("tables")) {
             const json& tables_json = config["tables"];
@@ -117,6 +608,25 @@ void DatabaseMigrator::load_config() {
             tables.clear();
         }
 
+        //      ,     
+        for (const auto& target : targets) {
+            for (const auto& table : tables)
+                target.resolve(table);
+        }
+
+        for (const auto& table : tables) {
+            for (const auto& shard_name : table.shard.targets) {
+                auto target = std::find_if(targets.begin(), targets.end(),
+                    [&](const TargetConfig& t) { return t.name == shard_name; });
+                if (target == targets.end())
+                    throw std::domain_error("Shard " + shard_name + " of table " + table.source +
+                        " isn't a target database (json id=302)");
+                if (target->resolve(table).exclude)
+                    throw std::domain_error("Table " + table.source + " can't be excluded for its shard " +
+                        shard_name + " (json id=302)");
+            }
+        }
+
         Logger::log(Logger::INFO, "DatabaseMigrator", "Configuration loaded successfully");
         isConfigInitialized = true;
     }
@@ -125,6 +635,11 @@ void DatabaseMigrator::load_config() {
             "Error loading configuration: " + std::string(e.what()));
         throw;
     }
+    catch (const std::domain_error& e) {
+        Logger::log(Logger::ERROR, "DatabaseMigrator",
+            "Error loading configuration: " + std::string(e.what()));
+        throw;
+    }
 }
 
 std::string DatabaseMigrator::create_connection_string(const DatabaseConfig& config) {
@@ -153,6 +668,36 @@ bool DatabaseMigrator::execute_migration() {
     }
 }
 
+bool DatabaseMigrator::execute_verification() {
+    Logger::log(Logger::INFO, "DatabaseMigrator", "Starting migration verification");
+
+    if (!isConfigInitialized)
+        throw std::runtime_error("Configuration file isn't set");
+    if (source_backup.enabled())
+        throw std::runtime_error("Verification requires source_database: the source of this migration is a backup");
+
+    try {
+        bool matches = true;
+        for (const auto& target : targets) {
+            for (const auto& table : tables) {
+                if (table.exclude) continue;
+                if (!verify_table(table, target))
+                    matches = false;
+            }
+        }
+
+        Logger::log(matches ? Logger::INFO : Logger::WARN, "DatabaseMigrator",
+            matches ? "Verification completed: target matches source" :
+                      "Verification completed: target differs from source");
+        return matches;
+    }
+    catch (const std::exception& e) {
+        Logger::log(Logger::ERROR, "DatabaseMigrator",
+            "Verification failed: " + std::string(e.what()));
+        throw;
+    }
+}
+
 void DatabaseMigrator::migrate() {
     int total_rows = 0;
     int current_rows = 0;
@@ -160,22 +705,88 @@ void DatabaseMigrator::migrate() {
     if (!isConfigInitialized)
         throw std::runtime_error("Configuration file isn't set");
 
-    if (callback_ != nullptr) {
+    failed_targets.assign(targets.size(), false);
+    colocated_targets.assign(targets.size(), -1);
+
+    //     :     
+    if (source_backup.enabled()) {
+        migrate_from_backup();
+    }
+    else {
+        if (callback_ != nullptr) {
+            for (const auto& table : tables) {
+                if (table.exclude) continue;
+
+                PGconn* conn = PQconnectdb(create_connection_string(source_db).c_str());
+                PGresult* res = PQexec(conn, build_count_query(table).c_str());
+
+                if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+                    total_rows += std::stoi(PQgetvalue(res, 0, 0));
+                }
+                PQclear(res);
+                PQfinish(conn);
+            }
+        }
+    
         for (const auto& table : tables) {
-            if (table.exclude) continue;
+            if (table.exclude) {
+                Logger::log(Logger::INFO, "DatabaseMigrator",
+                    "Skipping excluded table: " + table.source);
+                continue;
+            }
+
+            migrate_table(table);
 
-            PGconn* conn = PQconnectdb(create_connection_string(source_db).c_str());
-            PGresult* res = PQexec(conn,
-                ("SELECT COUNT(*) FROM " + table.source).c_str());
+            if (callback_ != nullptr) {
+                PGconn* conn = PQconnectdb(create_connection_string(source_db).c_str());
+                PGresult* res = PQexec(conn, build_count_query(table).c_str());
 
-            if (PQresultStatus(res) == PGRES_TUPLES_OK) {
-                total_rows += std::stoi(PQgetvalue(res, 0, 0));
+                if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+                    current_rows += std::stoi(PQgetvalue(res, 0, 0));
+                }
+                PQclear(res);
+                PQfinish(conn);
+
+                int progress = (current_rows * 100) / total_rows;
+                callback_(progress);
             }
-            PQclear(res);
-            PQfinish(conn);
         }
     }
-    
+
+    if (large_objects.enabled && source_backup.enabled()) {
+        Logger::log(Logger::WARN, "DatabaseMigrator",
+            "Large objects aren't stored in backups and aren't migrated");
+    }
+    else if (large_objects.enabled) {
+        migrate_large_objects();
+    }
+
+    //        ,    
+    std::string failed;
+    for (size_t i = 0; i < targets.size(); i++) {
+        if (!failed_targets[i]) continue;
+        failed += (failed.empty() ? "" : ", ") + targets[i].name;
+    }
+    if (!failed.empty())
+        throw std::runtime_error("Migration failed for target database(s): " + failed);
+}
+
+//        threads ,   
+//  threads  ;        , 
+//   ,  .      COPY 
+void DatabaseMigrator::migrate_from_backup() {
+    std::string manifest_path = BackupManifest::is_manifest(source_backup.file) ?
+        source_backup.file : source_backup.file + ".manifest";
+    if (!std::ifstream(manifest_path).is_open())
+        throw std::runtime_error("Backup " + source_backup.file + " has no manifest " + manifest_path +
+            ": create the backup again");
+
+    BackupManifest manifest;
+    manifest.load(manifest_path);
+
+    std::vector<TableConfig> staged_tables;
+    std::vector<const ManifestTable*> stored_tables;
+    long long total_bytes = 0;
     for (const auto& table : tables) {
         if (table.exclude) {
             Logger::log(Logger::INFO, "DatabaseMigrator",
@@ -183,111 +794,1631 @@ void DatabaseMigrator::migrate() {
             continue;
         }
 
-        migrate_table(table);
+        const ManifestTable* stored = manifest.find(table.source);
+        if (!stored)
+            throw std::runtime_error("Table " + table.source + " isn't in backup " + source_backup.file);
+        if (stored->columns.empty())
+            throw std::runtime_error("Backup " + source_backup.file + " has no columns of " + table.source +
+                ": create the backup again");
 
-        if (callback_ != nullptr) {
-            PGconn* conn = PQconnectdb(create_connection_string(source_db).c_str());
-            PGresult* res = PQexec(conn,
-                ("SELECT COUNT(*) FROM " + table.source).c_str());
+        TableConfig staged = table;
+        staged.relation = table.source;
+        std::replace(staged.relation.begin(), staged.relation.end(), '.', '_');
+        staged.relation = BACKUP_SCHEMA + "." + staged.relation;
+        staged_tables.push_back(staged);
+        stored_tables.push_back(stored);
+        total_bytes += stored->size;
+    }
 
-            if (PQresultStatus(res) == PGRES_TUPLES_OK) {
-                current_rows += std::stoi(PQgetvalue(res, 0, 0));
+    size_t count = staged_tables.size();
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t next = 0;
+    size_t migrated = 0;
+    bool stop = false;
+    std::vector<bool> loaded(count, false);
+    std::vector<std::string> errors(count);
+
+    auto stage = [&]() {
+        while (true) {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] {
+                    return stop || next >= count || next < migrated + (size_t)source_backup.threads;
+                });
+                if (stop || next >= count)
+                    return;
+                index = next++;
+            }
+
+            std::string error;
+            try {
+                stage_backup_table(manifest, *stored_tables[index], staged_tables[index].relation);
+            }
+            catch (const std::exception& e) {
+                error = e.what();
             }
-            PQclear(res);
-            PQfinish(conn);
 
-            int progress = (current_rows * 100) / total_rows;
-            callback_(progress);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                loaded[index] = true;
+                errors[index] = error;
+            }
+            changed.notify_all();
         }
-    }
-}
+    };
 
-void DatabaseMigrator::migrate_table(const TableConfig& table_config) {
-    PGconn* source_conn = nullptr;
-    PGconn* target_conn = nullptr;
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < std::min(count, (size_t)source_backup.threads); i++)
+        workers.emplace_back(stage);
 
+    PGconn* conn = nullptr;
+    size_t current = 0;
+    long long current_bytes = 0;
     try {
-        source_conn = PQconnectdb(create_connection_string(source_db).c_str());
-        target_conn = PQconnectdb(create_connection_string(target_db).c_str());
+        conn = PQconnectdb(create_connection_string(source_db).c_str());
+        if (PQstatus(conn) != CONNECTION_OK)
+            throw std::runtime_error("Failed to connect to backup staging database");
 
-        if (PQstatus(source_conn) != CONNECTION_OK) {
-            throw std::runtime_error("Failed to connect to source database");
-        }
-        if (PQstatus(target_conn) != CONNECTION_OK) {
-            throw std::runtime_error("Failed to connect to target database");
-        }
+        for (; current < count; current++) {
+            const TableConfig& staged = staged_tables[current];
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return loaded[current]; });
+            }
+            if (!errors[current].empty())
+                throw std::runtime_error("Failed to load table " + staged.source + " from backup: " + errors[current]);
 
-        //   ( )
-        if (table_config.create_if_missing) {
-            std::string ddl = generate_ddl(table_config);
-            Logger::log(Logger::INFO, "DatabaseMigrator",
-                "Creating table: " + (table_config.target.empty() ? table_config.source : table_config.target));
+            migrate_table(staged);
+            execute_command(conn, "DROP TABLE IF EXISTS " + staged.relation);
 
-            PGresult* res = PQexec(target_conn, ddl.c_str());
-            if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-                throw std::runtime_error("Failed to create table");
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                migrated++;
             }
-            PQclear(res);
+            changed.notify_all();
+
+            current_bytes += stored_tables[current]->size;
+            if (callback_ != nullptr && total_bytes > 0)
+                callback_((int)(current_bytes * 100 / total_bytes));
+        }
+    }
+    catch (const std::exception&) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        changed.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+
+        // ,     
+        if (conn && PQstatus(conn) == CONNECTION_OK) {
+            for (size_t i = current; i < count; i++)
+                PQclear(PQexec(conn, ("DROP TABLE IF EXISTS " + staged_tables[i].relation).c_str()));
         }
+        if (conn) PQfinish(conn);
+        throw;
+    }
 
-        std::string query = "SELECT * FROM " + table_config.source;
-        PGresult* res = PQexec(source_conn, query.c_str());
+    for (auto& worker : workers)
+        worker.join();
 
-        if (PQresultStatus(res) == PGRES_TUPLES_OK) {
-            int rows = PQntuples(res);
-            int cols = PQnfields(res);
+    //  ,        
+    PQclear(PQexec(conn, ("DROP SCHEMA IF EXISTS " + BACKUP_SCHEMA).c_str()));
+    PQfinish(conn);
+}
 
-            for (int row = 0; row < rows; row++) {
-                std::stringstream insert_stmt;
-                insert_stmt << "INSERT INTO "
-                    << (table_config.target.empty() ? table_config.source : table_config.target)
-                    << " VALUES (";
+//  COPY         
+//    
+void DatabaseMigrator::stage_backup_table(const BackupManifest& manifest, const ManifestTable& table,
+    const std::string& staged_table) {
+    PGconn* conn = PQconnectdb(create_connection_string(source_db).c_str());
 
-                for (int col = 0; col < cols; col++) {
-                    if (col > 0) insert_stmt << ",";
+    try {
+        if (PQstatus(conn) != CONNECTION_OK)
+            throw std::runtime_error("Failed to connect to backup staging database");
 
-                    const char* value = PQgetvalue(res, row, col);
-                    if (value && *value) {
-                        std::string converted = convert_value(value,
-                            table_config.columns.at(PQfname(res, col)).at("type"));
-                        insert_stmt << "'" << converted << "'";
-                    }
-                    else {
-                        insert_stmt << "NULL";
-                    }
-                }
+        std::string definition;
+        for (size_t i = 0; i < table.columns.size(); i++) {
+            const ManifestColumn& column = table.columns[i];
+            char* name = PQescapeIdentifier(conn, column.name.c_str(), column.name.size());
+            if (!name)
+                throw std::runtime_error("Invalid column name " + column.name + ": " + PQerrorMessage(conn));
+            definition += (i > 0 ? ", " : "") + std::string(name) + " " + column.type;
+            PQfreemem(name);
+        }
 
-                insert_stmt << ")";
+        execute_command(conn, "CREATE SCHEMA IF NOT EXISTS " + BACKUP_SCHEMA);
+        execute_command(conn, "DROP TABLE IF EXISTS " + staged_table);
+        execute_command(conn, "CREATE UNLOGGED TABLE " + staged_table + " (" + definition + ")");
 
-                PGresult* insert_res = PQexec(target_conn, insert_stmt.str().c_str());
-                if (PQresultStatus(insert_res) != PGRES_COMMAND_OK) {
-                    throw std::runtime_error("Failed to insert data");
-                }
-                PQclear(insert_res);
-            }
+        //     ,   -     
+        std::unique_ptr<ChunkStore> store;
+        std::unique_ptr<ChunkStreamReader> chunks;
+        std::unique_ptr<BackupReader> file;
+        if (manifest.format == "chunks") {
+            store.reset(new ChunkStore(source_backup.repository.empty() ? manifest.repository : source_backup.repository));
+            chunks.reset(new ChunkStreamReader(*store, table.chunks, BACKUP_CHUNK_THREADS));
+        }
+        else {
+            std::string path = BackupManifest::is_manifest(source_backup.file) ? manifest.file : source_backup.file;
+            file.reset(new BackupReader(path, source_backup.io, table.offset, table.size));
+            if (!file->is_open())
+                throw std::runtime_error("Failed to open backup file: " + path);
+        }
+
+        PGresult* res = PQexec(conn, ("COPY " + staged_table + " FROM STDIN BINARY").c_str());
+        bool started = PQresultStatus(res) == PGRES_COPY_IN;
+        PQclear(res);
+        if (!started)
+            throw std::runtime_error("Failed to load " + staged_table + ": " + PQerrorMessage(conn));
+
+        bool sent = true;
+        try {
+            const char* data = nullptr;
+            size_t length;
+            while (sent && (length = chunks ? chunks->next(data) : file->next(data)) > 0)
+                sent = PQputCopyData(conn, data, (int)length) == 1;
+        }
+        catch (const std::exception&) {
+            PQputCopyEnd(conn, "backup read failed");
+            while ((res = PQgetResult(conn)) != nullptr)
+                PQclear(res);
+            throw;
         }
 
+        PQputCopyEnd(conn, sent ? NULL : "backup load aborted");
+        res = PQgetResult(conn);
+        bool loaded = sent && PQresultStatus(res) == PGRES_COMMAND_OK;
         PQclear(res);
+        while ((res = PQgetResult(conn)) != nullptr)
+            PQclear(res);
+
+        if (!loaded)
+            throw std::runtime_error("Failed to load " + staged_table + ": " + PQerrorMessage(conn));
     }
-    catch (const std::exception& e) {
-        Logger::log(Logger::ERROR, "DatabaseMigrator",
-            "Error migrating table " + table_config.source + ": " + std::string(e.what()));
+    catch (const std::exception&) {
+        PQfinish(conn);
         throw;
     }
 
-    if (source_conn) PQfinish(source_conn);
-    if (target_conn) PQfinish(target_conn);
+    PQfinish(conn);
 }
 
-std::string DatabaseMigrator::generate_ddl(const TableConfig& table_config) {
-    std::stringstream ddl;
-    ddl << "CREATE TABLE IF NOT EXISTS "
-        << (table_config.target.empty() ? table_config.source : table_config.target)
-        << " (\n";
+//      
+struct TargetLoad {
+    size_t target;                  //     targets
+    int shard;                      //    (-1 -    )
+    TableConfig table;              //      
+    std::string target_table;
+    std::string load_table;
+    PGconn* conn;
+    std::vector<std::string> target_names;  //  
+    std::vector<int> indexes;               //     
+    std::unique_ptr<TableWriter> writer;
+    size_t pipeline_index;          //    
+    std::string offload_sql;        // INSERT ... SELECT,      
+    std::string offload_cleanup;    //     
+    long long offloaded_rows;
+    std::string error;              //  ;     
 
-    std::vector<std::string> columns;
+    TargetLoad(size_t target, int shard, const TableConfig& table)
+        : target(target), shard(shard), table(table), conn(nullptr), pipeline_index(0), offloaded_rows(0) {
+        target_table = table.target.empty() ? table.source : table.target;
+        load_table = target_table;
+    }
+};
 
-    for (const auto& col : table_config.columns) {
+void DatabaseMigrator::migrate_table(const TableConfig& table_config) {
+    PGconn* source_conn = nullptr;
+    PGresult* res = nullptr;
+    std::vector<std::unique_ptr<TargetLoad>> loads;
+    std::vector<std::thread> offloads;
+
+    try {
+        source_conn = PQconnectdb(create_connection_string(source_db).c_str());
+
+        if (PQstatus(source_conn) != CONNECTION_OK) {
+            throw std::runtime_error("Failed to connect to source database");
+        }
+
+        // ,    , ,   
+        //  "exclude": false;    
+        TableConfig fetch_config = table_config;
+        for (size_t i = 0; i < targets.size(); i++) {
+            if (failed_targets[i]) continue;
+            TableConfig resolved = targets[i].resolve(table_config);
+            if (resolved.exclude) continue;
+            for (const auto& column : resolved.columns) {
+                if (column.second.count("exclude") == 0 || column.second.at("exclude") != "true")
+                    fetch_config.columns[column.first].erase("exclude");
+            }
+        }
+
+        //      ,  -   
+        std::vector<ColumnMapping> mapping = map_columns(fetch_config);
+        std::string query = build_source_query(fetch_config, mapping);
+
+        res = PQprepare(source_conn, "", query.c_str(), 0, nullptr);
+        if (PQresultStatus(res) != PGRES_COMMAND_OK)
+            throw std::runtime_error("Failed to read source table: " + std::string(PQerrorMessage(source_conn)));
+        PQclear(res);
+
+        res = PQdescribePrepared(source_conn, "");
+        if (PQresultStatus(res) != PGRES_COMMAND_OK)
+            throw std::runtime_error("Failed to read source table: " + std::string(PQerrorMessage(source_conn)));
+
+        //  upsert          ,
+        //      (OID     )
+        std::vector<std::string> columns = target_columns(res, mapping);
+        std::vector<Oid> types;
+        bool binary = std::none_of(mapping.begin(), mapping.end(),
+            [](const ColumnMapping& column) { return column.client; });
+        for (int col = 0; col < PQnfields(res); col++) {
+            types.push_back(PQftype(res, col));
+            if (types.back() >= FIRST_NORMAL_OID)
+                binary = false;
+        }
+        PQclear(res);
+        res = nullptr;
+
+        //       
+        const ShardConfig& shard = table_config.shard;
+        int shard_key = -1;
+        if (shard.enabled()) {
+            for (size_t col = 0; col < columns.size(); col++) {
+                if ((mapping.empty() ? columns[col] : mapping[col].source) == shard.key)
+                    shard_key = (int)col;
+            }
+            if (shard_key < 0)
+                throw std::runtime_error("Shard key " + shard.key + " isn't among migrated columns");
+            binary = false;
+        }
+
+        for (size_t i = 0; i < targets.size(); i++) {
+            if (failed_targets[i]) continue;
+
+            TableConfig resolved = targets[i].resolve(table_config);
+            if (resolved.exclude) {
+                Logger::log(Logger::INFO, "DatabaseMigrator",
+                    "Skipping excluded table " + table_config.source + " for target " + targets[i].name);
+                continue;
+            }
+
+            auto shard_name = std::find(shard.targets.begin(), shard.targets.end(), targets[i].name);
+            int shard_number = shard_name == shard.targets.end() ? -1 : (int)(shard_name - shard.targets.begin());
+            loads.emplace_back(new TargetLoad(i, shard_number, resolved));
+        }
+
+        for (auto& load : loads) {
+            try {
+                open_target(*load, source_conn, mapping, columns);
+            }
+            catch (const std::exception& e) {
+                fail_target(*load, e.what());
+            }
+        }
+
+        //     ,    :
+        //  -      upsert
+        for (auto& load : loads) {
+            if (load->conn && load->offload_sql.empty())
+                binary = binary && load->table.upsert.enabled;
+        }
+        for (auto& load : loads) {
+            if (!load->conn || !load->offload_sql.empty()) continue;
+            try {
+                create_writer(*load, types, binary);
+            }
+            catch (const std::exception& e) {
+                fail_target(*load, e.what());
+            }
+        }
+        loads.erase(std::remove_if(loads.begin(), loads.end(),
+            [](const std::unique_ptr<TargetLoad>& load) { return !load->conn; }), loads.end());
+
+        if (loads.empty()) {
+            Logger::log(Logger::WARN, "DatabaseMigrator",
+                "Table " + table_config.source + " isn't migrated: no target database available");
+            PQfinish(source_conn);
+            return;
+        }
+
+        //           
+        std::vector<MigrationPipeline::Writer> writers;
+        for (auto& load : loads) {
+            if (!load->offload_sql.empty()) {
+                TargetLoad* offload = load.get();
+                offloads.emplace_back([this, offload]() { run_offload(*offload); });
+                continue;
+            }
+
+            TableWriter* writer = load->writer.get();
+            load->pipeline_index = writers.size();
+            writers.push_back({ targets[load->target].name, [writer](const RowBatch& batch) { writer->write(batch); } });
+        }
+
+        MigrationPipeline migration_pipeline((size_t)pipeline.memory_limit, (size_t)pipeline.target_buffer);
+        std::unique_ptr<AdaptiveTuner> fetch_tuner;
+        std::vector<TargetLoad*> written;
+        if (!writers.empty()) {
+            //      fetch_rows.   
+            //       -    
+            execute_command(source_conn, table_config.large_values.enabled() ?
+                "BEGIN ISOLATION LEVEL REPEATABLE READ READ ONLY" : "BEGIN");
+            execute_command(source_conn, "DECLARE migrate_cursor NO SCROLL CURSOR FOR " + query);
+            std::string fetch_sql = "FETCH FORWARD " + std::to_string(pipeline.fetch_rows) + " FROM migrate_cursor";
+
+            //      ,   .  - 
+            //  :    ,     ,
+            //          
+            if (tuning.enabled) {
+                fetch_tuner.reset(new AdaptiveTuner("Table " + table_config.source + " fetch_rows",
+                    pipeline.fetch_rows, tuning.fetch_rows, tuning.window));
+            }
+            std::chrono::steady_clock::time_point fetch_started;
+            int fetched_rows = -1;
+            auto fetch = [&](RowBatch& batch) {
+                if (!fetch_tuner) {
+                    fetch_batch(source_conn, fetch_sql, binary, batch);
+                    return;
+                }
+
+                auto now = std::chrono::steady_clock::now();
+                if (fetched_rows >= 0)
+                    fetch_tuner->update(fetched_rows, std::chrono::duration<double>(now - fetch_started).count());
+                fetch_started = now;
+                fetch_batch(source_conn, "FETCH FORWARD " + std::to_string(fetch_tuner->value()) + " FROM migrate_cursor",
+                    binary, batch);
+                fetched_rows = batch.rows();
+            };
+
+            // ,        ;
+            //      ,     
+            bool client_convert = std::any_of(mapping.begin(), mapping.end(),
+                [](const ColumnMapping& column) { return column.client; });
+            RowBatch scratch;
+            migration_pipeline.run(
+                fetch,
+                [&](RowBatch& batch) {
+                    if (client_convert) convert_batch(batch, scratch, mapping);
+                    if (shard_key >= 0) route_batch(batch, shard_key, shard);
+                },
+                writers);
+
+            for (auto& target_load : loads) {
+                TargetLoad& load = *target_load;
+                if (!load.writer) continue;
+
+                load.error = migration_pipeline.error(load.pipeline_index);
+                if (load.error.empty()) {
+                    try {
+                        load.writer->finish();
+                        written.push_back(&load);
+                    }
+                    catch (const std::exception& e) {
+                        load.error = e.what();
+                    }
+                }
+            }
+
+            if (table_config.large_values.enabled())
+                migrate_large_values(source_conn, table_config, written);
+
+            execute_command(source_conn, "COMMIT");
+        }
+
+        for (auto& offload : offloads)
+            offload.join();
+        offloads.clear();
+
+        long long sharded_rows = 0;
+        bool shards_complete = shard.enabled() && !writers.empty();
+        std::string tuned = fetch_tuner ? fetch_tuner->report() : "";
+        for (auto& target_load : loads) {
+            TargetLoad& load = *target_load;
+
+            if (load.error.empty() && load.load_table != load.target_table) {
+                try {
+                    swap_staging_table(load.conn, load.load_table, load.target_table);
+                }
+                catch (const std::exception& e) {
+                    load.error = e.what();
+                }
+            }
+
+            if (!load.error.empty()) {
+                shards_complete = shards_complete && load.shard < 0;
+                fail_target(load, load.error);
+                continue;
+            }
+
+            long long rows = load.writer ? load.writer->rows() : load.offloaded_rows;
+            if (load.shard >= 0)
+                sharded_rows += rows;
+
+            Logger::log(Logger::INFO, "DatabaseMigrator",
+                "Table " + table_config.source + " -> " + targets[load.target].name +
+                (load.shard >= 0 ? " (shard " + std::to_string(load.shard) + ")" : "") +
+                (load.writer ? "" : " (server-side)") + ": " +
+                std::to_string(rows) + " rows migrated");
+            if (load.writer && !load.writer->tuning_report().empty())
+                tuned += "; " + load.writer->tuning_report();
+            load.writer.reset();
+            PQfinish(load.conn);
+            load.conn = nullptr;
+        }
+
+        //         
+        if (shards_complete) {
+            long long read_rows = migration_pipeline.read_rows();
+            Logger::log(sharded_rows == read_rows ? Logger::INFO : Logger::WARN, "DatabaseMigrator",
+                "Table " + table_config.source + ": " + std::to_string(read_rows) + " rows read, " +
+                std::to_string(sharded_rows) + " rows written to " + std::to_string(shard.targets.size()) + " shards");
+        }
+
+        if (!writers.empty()) {
+            Logger::log(Logger::INFO, "DatabaseMigrator",
+                "Table " + table_config.source + ": " + migration_pipeline.utilization());
+        }
+
+        //      config-  
+        if (!tuned.empty())
+            Logger::log(Logger::INFO, "DatabaseMigrator", "Tuned settings: " + tuned);
+    }
+    catch (const std::exception& e) {
+        Logger::log(Logger::ERROR, "DatabaseMigrator",
+            "Error migrating table " + table_config.source + ": " + std::string(e.what()));
+
+        //          
+        for (auto& offload : offloads)
+            offload.join();
+
+        for (auto& load : loads) {
+            if (!load->conn) continue;
+
+            //     :   
+            load->writer.reset();
+            if (load->load_table != load->target_table) {
+                PQclear(PQexec(load->conn, "ROLLBACK"));
+                PQclear(PQexec(load->conn, ("DROP TABLE IF EXISTS " + load->load_table).c_str()));
+            }
+            PQfinish(load->conn);
+            load->conn = nullptr;
+        }
+
+        if (res) PQclear(res);
+        if (source_conn) PQfinish(source_conn);
+        throw;
+    }
+
+    if (source_conn) PQfinish(source_conn);
+}
+
+//   ,     ,    
+void DatabaseMigrator::open_target(TargetLoad& load, PGconn* source_conn, const std::vector<ColumnMapping>& mapping,
+    const std::vector<std::string>& columns) {
+    const TableConfig& table_config = load.table;
+    const BulkLoadConfig& bulk_load = table_config.bulk_load;
+
+    load.conn = PQconnectdb(create_connection_string(targets[load.target].database).c_str());
+    if (PQstatus(load.conn) != CONNECTION_OK) {
+        throw std::runtime_error("Failed to connect to target database");
+    }
+
+    //   ( )
+    if (table_config.create_if_missing) {
+        std::string ddl = generate_ddl(table_config);
+        Logger::log(Logger::INFO, "DatabaseMigrator",
+            "Creating table " + load.target_table + " in " + targets[load.target].name);
+
+        PGresult* ddl_res = PQexec(load.conn, ddl.c_str());
+        if (PQresultStatus(ddl_res) != PGRES_COMMAND_OK) {
+            PQclear(ddl_res);
+            throw std::runtime_error("Failed to create table");
+        }
+        PQclear(ddl_res);
+    }
+
+    if (bulk_load.enabled) {
+        configure_loader_session(load.conn, bulk_load);
+        if (bulk_load.staging)
+            load.load_table = create_staging_table(load.conn, load.target_table);
+    }
+
+    //   -  ;    
+    if (mapping.empty()) {
+        load.target_names = columns;
+        for (size_t col = 0; col < columns.size(); col++)
+            load.indexes.push_back((int)col);
+    }
+    else {
+        for (const auto& column : map_columns(table_config)) {
+            for (size_t col = 0; col < mapping.size(); col++) {
+                if (mapping[col].source != column.source) continue;
+                load.target_names.push_back(column.target);
+                load.indexes.push_back((int)col);
+                break;
+            }
+        }
+    }
+
+    const OffloadConfig& offload = targets[load.target].offload;
+    if (offload.detect || offload.enabled)
+        load.offload_sql = build_offload_query(load, source_conn, mapping, columns);
+}
+
+//     :    
+static std::vector<std::string> query_values(PGconn* conn, const std::string& query, const std::vector<std::string>& params) {
+    std::vector<const char*> values;
+    for (const auto& param : params)
+        values.push_back(param.c_str());
+
+    PGresult* res = PQexecParams(conn, query.c_str(), (int)values.size(), nullptr, values.data(), nullptr, nullptr, 0);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        std::string error_msg = PQerrorMessage(conn);
+        PQclear(res);
+        throw std::runtime_error("Failed to execute '" + query + "': " + error_msg);
+    }
+
+    std::vector<std::string> result;
+    for (int row = 0; row < PQntuples(res); row++) {
+        for (int col = 0; col < PQnfields(res); col++)
+            result.push_back(PQgetvalue(res, row, col));
+    }
+    PQclear(res);
+    return result;
+}
+
+void DatabaseMigrator::create_writer(TargetLoad& load, const std::vector<Oid>& types, bool binary) {
+    const TableConfig& table_config = load.table;
+    const BulkLoadConfig& bulk_load = table_config.bulk_load;
+
+    //  upsert    COPY. COPY    (RULE)   
+    //    INSTEAD OF  -     INSERT
+    bool insert_only = !table_config.upsert.enabled && query_values(load.conn,
+        "SELECT c.relkind = 'v' OR c.relhasrules FROM pg_class c WHERE c.oid = $1::regclass",
+        { load.load_table }) != std::vector<std::string>{ "f" };
+    if (table_config.upsert.enabled)
+        load.writer.reset(new UpsertWriter(load.conn, load.load_table, load.target_names, load.indexes, types,
+            bulk_load, table_config.upsert, binary));
+    else if (!insert_only) {
+        CopyWriter* writer = new CopyWriter(load.conn, load.load_table, load.target_names, load.indexes, bulk_load);
+        load.writer.reset(writer);
+        if (tuning.enabled) {
+            writer->tune_flush("Table " + table_config.source + " -> " + targets[load.target].name + " copy_buffer",
+                tuning.copy_buffer, tuning.window);
+        }
+    }
+    else
+        load.writer.reset(new InsertWriter(load.conn, load.load_table, load.target_names, load.indexes, bulk_load));
+    load.writer->set_shard(load.shard);
+
+    if (tuning.enabled && bulk_load.enabled) {
+        load.writer->tune_commit("Table " + table_config.source + " -> " + targets[load.target].name + " commit_rows",
+            tuning.commit_rows, tuning.window);
+    }
+
+    //         staging:   ,
+    //     COMMIT,   
+    if (bulk_load.enabled && !bulk_load.staging &&
+        (bulk_load.commit_rows > 0 || bulk_load.commit_bytes > 0 || tuning.enabled)) {
+        Logger::log(Logger::WARN, "DatabaseMigrator",
+            "Table " + load.target_table + " in " + targets[load.target].name +
+            " is committed in intervals without staging: rows loaded before a failure stay in the table");
+    }
+}
+
+// INSERT ... SELECT          .
+//   -    :    ,
+//    ,     
+std::string DatabaseMigrator::build_offload_query(TargetLoad& load, PGconn* source_conn,
+    const std::vector<ColumnMapping>& mapping, const std::vector<std::string>& columns) {
+    const OffloadConfig& offload = targets[load.target].offload;
+    const TableConfig& table_config = load.table;
+
+    if (table_config.shard.enabled())
+        return "";
+
+    //    pushdown     ;
+    //     
+    std::vector<std::string> expressions;
+    for (int index : load.indexes) {
+        if (mapping.empty()) {
+            expressions.push_back(columns[index]);
+            continue;
+        }
+        if (mapping[index].client)
+            return "";
+        expressions.push_back(mapping[index].expression);
+    }
+
+    std::string select_list;
+    for (size_t i = 0; i < expressions.size(); i++)
+        select_list += (i > 0 ? ", " : "") + expressions[i];
+
+    std::string source = table_config.source_relation();
+    std::string from;
+    std::string where = table_config.where;
+    if (offload.detect && is_colocated(load.target, source_conn, load.conn)) {
+        from = source;
+    }
+    else if (!offload.enabled) {
+        return "";
+    }
+    else if (offload.link == "postgres_fdw") {
+        //     ;      fdw
+        size_t dot = source.find('.');
+        std::string remote_schema = dot == std::string::npos ? "public" : source.substr(0, dot);
+        std::string remote_table = dot == std::string::npos ? source : source.substr(dot + 1);
+        from = offload.schema + "." + remote_table;
+
+        execute_command(load.conn, "CREATE SCHEMA IF NOT EXISTS " + offload.schema);
+        execute_command(load.conn, "DROP FOREIGN TABLE IF EXISTS " + from);
+        execute_command(load.conn, "IMPORT FOREIGN SCHEMA " + remote_schema + " LIMIT TO (" + remote_table +
+            ") FROM SERVER " + offload.server + " INTO " + offload.schema);
+        load.offload_cleanup = "DROP FOREIGN TABLE IF EXISTS " + from;
+    }
+    else if (offload.link == "dblink") {
+        //   ;   dblink    
+        std::string remote = "SELECT " + select_list + " FROM " + source +
+            (where.empty() ? "" : " WHERE " + where);
+
+        PGresult* res = PQprepare(source_conn, "offload_describe", remote.c_str(), 0, nullptr);
+        bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+        PQclear(res);
+        if (!ok)
+            throw std::runtime_error("Failed to describe offload query: " + std::string(PQerrorMessage(source_conn)));
+
+        res = PQdescribePrepared(source_conn, "offload_describe");
+        std::vector<std::pair<std::string, std::string>> fields;
+        for (int col = 0; PQresultStatus(res) == PGRES_COMMAND_OK && col < PQnfields(res); col++)
+            fields.emplace_back(std::to_string(PQftype(res, col)), std::to_string(PQfmod(res, col)));
+        PQclear(res);
+        PQclear(PQexec(source_conn, "DEALLOCATE offload_describe"));
+
+        std::string definition;
+        for (size_t col = 0; col < fields.size(); col++) {
+            const char* params[2] = { fields[col].first.c_str(), fields[col].second.c_str() };
+            res = PQexecParams(source_conn, "SELECT format_type($1::oid, $2::integer)", 2, nullptr, params, nullptr, nullptr, 0);
+            if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+                std::string error_msg = PQerrorMessage(source_conn);
+                PQclear(res);
+                throw std::runtime_error("Failed to describe offload query: " + error_msg);
+            }
+            definition += (col > 0 ? ", " : "") + std::string("c") + std::to_string(col + 1) + " " + PQgetvalue(res, 0, 0);
+            PQclear(res);
+        }
+
+        //  -      ,    
+        const std::string& link = offload.server;
+        char* link_literal = PQescapeLiteral(load.conn, link.c_str(), link.size());
+        char* remote_literal = PQescapeLiteral(load.conn, remote.c_str(), remote.size());
+        if (!link_literal || !remote_literal) {
+            PQfreemem(link_literal);
+            PQfreemem(remote_literal);
+            throw std::runtime_error("Failed to build offload query: " + std::string(PQerrorMessage(load.conn)));
+        }
+        from = "dblink(" + std::string(link_literal) + ", " + remote_literal + ") AS offload(" + definition + ")";
+        PQfreemem(link_literal);
+        PQfreemem(remote_literal);
+
+        select_list.clear();
+        for (size_t col = 0; col < fields.size(); col++)
+            select_list += (col > 0 ? ", " : "") + std::string("c") + std::to_string(col + 1);
+        where.clear();
+    }
+    else {
+        return "";
+    }
+
+    std::string target_list;
+    for (size_t i = 0; i < load.target_names.size(); i++)
+        target_list += (i > 0 ? ", " : "") + load.target_names[i];
+
+    std::string sql = "INSERT INTO " + load.load_table + " (" + target_list + ") SELECT " + select_list + " FROM " + from;
+    if (!where.empty())
+        sql += " WHERE " + where;
+    if (table_config.upsert.enabled)
+        sql += " " + build_conflict_clause(load.target_names, table_config.upsert);
+
+    return sql;
+}
+
+//    -  ,      pg_stat_activity 
+//    ;      
+bool DatabaseMigrator::is_colocated(size_t target, PGconn* source_conn, PGconn* target_conn) {
+    if (colocated_targets[target] < 0) {
+        std::string token = "migrator_probe_" + std::to_string(PQbackendPID(source_conn));
+        execute_command(target_conn, "SET application_name = '" + token + "'");
+
+        PGresult* res = PQexec(source_conn, ("SELECT 1 FROM pg_stat_activity WHERE pid = " +
+            std::to_string(PQbackendPID(target_conn)) + " AND application_name = '" + token +
+            "' AND datname = current_database()").c_str());
+        colocated_targets[target] = PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0 ? 1 : 0;
+        PQclear(res);
+
+        execute_command(target_conn, "RESET application_name");
+        if (colocated_targets[target] == 1) {
+            Logger::log(Logger::INFO, "DatabaseMigrator",
+                "Target " + targets[target].name + " shares the source database: tables are migrated server-side");
+        }
+    }
+    return colocated_targets[target] == 1;
+}
+
+//    ;    load.error
+void DatabaseMigrator::run_offload(TargetLoad& load) {
+    PGresult* res = PQexec(load.conn, load.offload_sql.c_str());
+    if (PQresultStatus(res) == PGRES_COMMAND_OK)
+        load.offloaded_rows = std::atoll(PQcmdTuples(res));
+    else
+        load.error = "Failed to migrate table server-side: " + std::string(PQerrorMessage(load.conn));
+    PQclear(res);
+
+    if (!load.offload_cleanup.empty())
+        PQclear(PQexec(load.conn, load.offload_cleanup.c_str()));
+}
+
+//      ;    
+void DatabaseMigrator::fail_target(TargetLoad& load, const std::string& error) {
+    Logger::log(Logger::ERROR, "DatabaseMigrator",
+        "Error migrating table " + load.table.source + " to " + targets[load.target].name + ": " + error);
+    failed_targets[load.target] = true;
+
+    load.writer.reset();
+    if (load.conn) {
+        if (load.load_table != load.target_table) {
+            PQclear(PQexec(load.conn, "ROLLBACK"));
+            PQclear(PQexec(load.conn, ("DROP TABLE IF EXISTS " + load.load_table).c_str()));
+        }
+        PQfinish(load.conn);
+        load.conn = nullptr;
+    }
+}
+
+void DatabaseMigrator::fetch_batch(PGconn* conn, const std::string& fetch_sql, bool binary, RowBatch& batch) {
+    PGresult* res = PQexecParams(conn, fetch_sql.c_str(), 0, nullptr, nullptr, nullptr, nullptr, binary ? 1 : 0);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        std::string error_msg = PQerrorMessage(conn);
+        PQclear(res);
+        throw std::runtime_error("Failed to read source table: " + error_msg);
+    }
+
+    int rows = PQntuples(res);
+    int cols = PQnfields(res);
+    batch.reset(cols);
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            if (PQgetisnull(res, row, col))
+                batch.add_null();
+            else
+                batch.add_value(PQgetvalue(res, row, col), PQgetlength(res, row, col));
+        }
+    }
+    PQclear(res);
+}
+
+void DatabaseMigrator::convert_batch(RowBatch& batch, RowBatch& scratch, const std::vector<ColumnMapping>& mapping) {
+    scratch.reset(batch.cols());
+    for (int row = 0; row < batch.rows(); row++) {
+        for (int col = 0; col < batch.cols(); col++) {
+            if (batch.is_null(row, col)) {
+                scratch.add_null();
+                continue;
+            }
+            if (!mapping[col].client) {
+                scratch.add_value(batch.value(row, col), batch.length(row, col));
+                continue;
+            }
+            std::string converted = convert_value(
+                std::string(batch.value(row, col), batch.length(row, col)), mapping[col].type);
+            scratch.add_value(converted.data(), (int)converted.size());
+        }
+    }
+    batch.swap(scratch);
+}
+
+//   threshold      NULL;   
+//           
+void DatabaseMigrator::migrate_large_values(PGconn* source_conn, const TableConfig& table_config,
+    const std::vector<TargetLoad*>& loads) {
+    const LargeValueConfig& large_values = table_config.large_values;
+    const ShardConfig& shard = table_config.shard;
+    std::vector<ColumnMapping> mapping = map_columns(table_config);
+
+    //  text    UTF8
+    if (PQsetClientEncoding(source_conn, "UTF8") != 0)
+        throw std::runtime_error("Failed to set client encoding: " + std::string(PQerrorMessage(source_conn)));
+    for (TargetLoad* load : loads) {
+        if (PQsetClientEncoding(load->conn, "UTF8") != 0)
+            load->error = "Failed to set client encoding: " + std::string(PQerrorMessage(load->conn));
+    }
+
+    //   ,   ,  
+    std::string list_columns;
+    for (size_t i = 0; i < large_values.key.size(); i++)
+        list_columns += (i > 0 ? ", " : "") + large_values.key[i];
+    if (shard.enabled())
+        list_columns += ", " + shard.key;
+
+    for (const auto& column_name : large_values.columns) {
+        std::string type;
+        for (const auto& column : mapping) {
+            if (column.source == column_name)
+                type = column.type;
+        }
+        bool base64 = type == "BASE64";
+
+        LargeValueReader reader(source_conn, table_config.source_relation(), column_name, large_values.key,
+            (size_t)large_values.chunk_size);
+
+        //      ;  -     
+        std::vector<std::string> updates(loads.size());
+        for (size_t i = 0; i < loads.size(); i++) {
+            std::string target_column;
+            std::vector<std::string> target_key(large_values.key.size());
+            for (const auto& column : map_columns(loads[i]->table)) {
+                if (column.source == column_name)
+                    target_column = column.target;
+                for (size_t k = 0; k < large_values.key.size(); k++) {
+                    if (column.source == large_values.key[k])
+                        target_key[k] = column.target;
+                }
+            }
+            if (target_column.empty())
+                continue;
+            if (std::find(target_key.begin(), target_key.end(), "") != target_key.end()) {
+                loads[i]->error = "Large value key of " + table_config.source + " isn't migrated";
+                continue;
+            }
+
+            //      :      
+            std::string key_array = "{";
+            for (size_t k = 0; k < target_key.size(); k++) {
+                key_array += k > 0 ? ",\"" : "\"";
+                for (char c : target_key[k]) {
+                    if (c == '"' || c == '\\') key_array += '\\';
+                    key_array += c;
+                }
+                key_array += "\"";
+            }
+            key_array += "}";
+            try {
+                std::vector<std::string> unique = query_values(loads[i]->conn,
+                    "SELECT count(*) FROM pg_index i WHERE i.indrelid = $1::regclass AND i.indisunique "
+                    "AND i.indpred IS NULL AND i.indexprs IS NULL AND NOT EXISTS (SELECT 1 FROM unnest(i.indkey::int2[]) k "
+                    "JOIN pg_attribute a ON a.attrelid = i.indrelid AND a.attnum = k WHERE a.attname <> ALL ($2::text[]))",
+                    { loads[i]->load_table, key_array });
+                if (unique.at(0) == "0") {
+                    loads[i]->error = "Large value key of " + table_config.source + " isn't unique in " + loads[i]->target_table;
+                    continue;
+                }
+            }
+            catch (const std::exception& e) {
+                loads[i]->error = e.what();
+                continue;
+            }
+
+            //          ,   
+            std::string value = reader.is_text() || base64 ?
+                "convert_from(lo_get($1::oid), 'UTF8')" : "lo_get($1::oid)";
+            if (!base64)
+                value = convert_expression(value, type);
+
+            updates[i] = "UPDATE " + loads[i]->load_table + " SET " + target_column + " = " + value + " WHERE ";
+            for (size_t k = 0; k < target_key.size(); k++) {
+                if (k > 0) updates[i] += " AND ";
+                updates[i] += target_key[k] + " = $" + std::to_string(k + 2);
+            }
+        }
+
+        std::string list_sql = "SELECT " + list_columns + " FROM " + table_config.source_relation() +
+            " WHERE octet_length(" + column_name + ") > " + std::to_string(large_values.threshold);
+        if (!table_config.where.empty())
+            list_sql += " AND (" + table_config.where + ")";
+
+        PGresult* res = PQexec(source_conn, list_sql.c_str());
+        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+            std::string error_msg = PQerrorMessage(source_conn);
+            PQclear(res);
+            throw std::runtime_error("Failed to list large values of " + table_config.source + ": " + error_msg);
+        }
+
+        std::vector<LargeObjectWriter> writers;
+        for (TargetLoad* load : loads)
+            writers.emplace_back(load->conn);
+
+        Base64Stream encoder;
+        std::string encoded;
+        std::string hex;
+        std::vector<std::string> key_values(large_values.key.size());
+        std::vector<size_t> active;
+        long long streamed = 0;
+
+        for (int row = 0; row < PQntuples(res); row++) {
+            for (size_t k = 0; k < key_values.size(); k++)
+                key_values[k] = PQgetvalue(res, row, (int)k);
+
+            int row_shard = -1;
+            if (shard.enabled()) {
+                int key_column = (int)key_values.size();
+                row_shard = shard.route(PQgetisnull(res, row, key_column) ? nullptr : PQgetvalue(res, row, key_column),
+                    PQgetlength(res, row, key_column));
+            }
+
+            active.clear();
+            for (size_t i = 0; i < loads.size(); i++) {
+                if (!loads[i]->error.empty() || updates[i].empty()) continue;
+                if (loads[i]->shard >= 0 && loads[i]->shard != row_shard) continue;
+                try {
+                    writers[i].begin();
+                    active.push_back(i);
+                }
+                catch (const std::exception& e) {
+                    loads[i]->error = e.what();
+                    writers[i].abort();
+                }
+            }
+            if (active.empty())
+                continue;
+
+            auto write_all = [&](const char* data, size_t length) {
+                for (size_t i : active) {
+                    if (!loads[i]->error.empty()) continue;
+                    try {
+                        writers[i].write(data, length);
+                    }
+                    catch (const std::exception& e) {
+                        loads[i]->error = e.what();
+                        writers[i].abort();
+                    }
+                }
+            };
+
+            // base64  bytea     '\x...',     text
+            encoder.reset();
+            if (base64 && !reader.is_text()) {
+                encoded.clear();
+                encoder.update("\\x", 2, encoded);
+                write_all(encoded.data(), encoded.size());
+            }
+
+            reader.open(key_values);
+            const char* data;
+            size_t length;
+            while ((length = reader.next(data)) > 0) {
+                if (!base64) {
+                    write_all(data, length);
+                    continue;
+                }
+
+                if (!reader.is_text()) {
+                    static const char HEX_DIGITS[] = "0123456789abcdef";
+                    hex.resize(length * 2);
+                    for (size_t pos = 0; pos < length; pos++) {
+                        hex[pos * 2] = HEX_DIGITS[(unsigned char)data[pos] >> 4];
+                        hex[pos * 2 + 1] = HEX_DIGITS[(unsigned char)data[pos] & 0x0F];
+                    }
+                    data = hex.data();
+                    length = hex.size();
+                }
+
+                encoded.clear();
+                encoder.update(data, length, encoded);
+                write_all(encoded.data(), encoded.size());
+            }
+
+            if (base64) {
+                encoded.clear();
+                encoder.finish(encoded);
+                write_all(encoded.data(), encoded.size());
+            }
+
+            for (size_t i : active) {
+                if (!loads[i]->error.empty()) continue;
+                try {
+                    if (writers[i].commit(updates[i], key_values) == 0) {
+                        Logger::log(Logger::WARN, "DatabaseMigrator",
+                            "Table " + table_config.source + " -> " + targets[loads[i]->target].name +
+                            ": no row for large value of " + column_name);
+                    }
+                }
+                catch (const std::exception& e) {
+                    loads[i]->error = e.what();
+                    writers[i].abort();
+                }
+            }
+            streamed++;
+        }
+        PQclear(res);
+
+        Logger::log(Logger::INFO, "DatabaseMigrator",
+            "Table " + table_config.source + ": " + std::to_string(streamed) +
+            " large values of " + column_name + " streamed");
+    }
+}
+
+//      OID,       oid  
+void DatabaseMigrator::migrate_large_objects() {
+    PGconn* source_conn = nullptr;
+    PGresult* res = nullptr;
+    std::vector<size_t> target_numbers;
+    std::vector<PGconn*> target_conns;
+    std::vector<char> buffer((size_t)large_objects.chunk_size);
+
+    auto fail = [&](size_t i, const std::string& error) {
+        Logger::log(Logger::ERROR, "DatabaseMigrator",
+            "Error migrating large objects to " + targets[target_numbers[i]].name + ": " + error);
+        failed_targets[target_numbers[i]] = true;
+        PQclear(PQexec(target_conns[i], "ROLLBACK"));
+        PQfinish(target_conns[i]);
+        target_conns[i] = nullptr;
+    };
+
+    try {
+        source_conn = PQconnectdb(create_connection_string(source_db).c_str());
+        if (PQstatus(source_conn) != CONNECTION_OK)
+            throw std::runtime_error("Failed to connect to source database");
+
+        for (size_t i = 0; i < targets.size(); i++) {
+            if (failed_targets[i]) continue;
+            target_numbers.push_back(i);
+            target_conns.push_back(PQconnectdb(create_connection_string(targets[i].database).c_str()));
+            if (PQstatus(target_conns.back()) != CONNECTION_OK)
+                fail(target_conns.size() - 1, "Failed to connect to target database");
+        }
+
+        execute_command(source_conn, "BEGIN ISOLATION LEVEL REPEATABLE READ READ ONLY");
+        res = PQexec(source_conn, "SELECT oid FROM pg_largeobject_metadata ORDER BY oid");
+        if (PQresultStatus(res) != PGRES_TUPLES_OK)
+            throw std::runtime_error("Failed to list large objects: " + std::string(PQerrorMessage(source_conn)));
+
+        std::vector<int> fds(target_conns.size());
+        for (int row = 0; row < PQntuples(res); row++) {
+            Oid oid = (Oid)std::stoul(PQgetvalue(res, row, 0));
+            std::string oid_str = PQgetvalue(res, row, 0);
+
+            int source_fd = lo_open(source_conn, oid, INV_READ);
+            if (source_fd < 0)
+                throw std::runtime_error("Failed to open large object " + oid_str + ": " + PQerrorMessage(source_conn));
+
+            //        OID 
+            for (size_t i = 0; i < target_conns.size(); i++) {
+                PGconn* conn = target_conns[i];
+                if (!conn) continue;
+                try {
+                    execute_command(conn, "BEGIN");
+                    PGresult* exists = PQexec(conn, ("SELECT 1 FROM pg_largeobject_metadata WHERE oid = " + oid_str).c_str());
+                    bool found = PQresultStatus(exists) == PGRES_TUPLES_OK && PQntuples(exists) > 0;
+                    PQclear(exists);
+
+                    if (!found && lo_create(conn, oid) != oid)
+                        throw std::runtime_error("Failed to create large object " + oid_str + ": " + PQerrorMessage(conn));
+                    fds[i] = lo_open(conn, oid, INV_WRITE);
+                    if (fds[i] < 0 || (found && lo_truncate64(conn, fds[i], 0) < 0))
+                        throw std::runtime_error("Failed to open large object " + oid_str + ": " + PQerrorMessage(conn));
+                }
+                catch (const std::exception& e) {
+                    fail(i, e.what());
+                }
+            }
+
+            int length;
+            while ((length = lo_read(source_conn, source_fd, buffer.data(), buffer.size())) > 0) {
+                for (size_t i = 0; i < target_conns.size(); i++) {
+                    if (target_conns[i] && lo_write(target_conns[i], fds[i], buffer.data(), (size_t)length) != length)
+                        fail(i, "Failed to write large object " + oid_str + ": " + PQerrorMessage(target_conns[i]));
+                }
+            }
+            if (length < 0)
+                throw std::runtime_error("Failed to read large object " + oid_str + ": " + PQerrorMessage(source_conn));
+            lo_close(source_conn, source_fd);
+
+            for (size_t i = 0; i < target_conns.size(); i++) {
+                if (!target_conns[i]) continue;
+                try {
+                    if (lo_close(target_conns[i], fds[i]) < 0)
+                        throw std::runtime_error("Failed to close large object " + oid_str + ": " + PQerrorMessage(target_conns[i]));
+                    execute_command(target_conns[i], "COMMIT");
+                }
+                catch (const std::exception& e) {
+                    fail(i, e.what());
+                }
+            }
+        }
+
+        Logger::log(Logger::INFO, "DatabaseMigrator",
+            std::to_string(PQntuples(res)) + " large objects migrated");
+        PQclear(res);
+        res = nullptr;
+        execute_command(source_conn, "COMMIT");
+    }
+    catch (const std::exception& e) {
+        Logger::log(Logger::ERROR, "DatabaseMigrator",
+            "Error migrating large objects: " + std::string(e.what()));
+
+        if (res) PQclear(res);
+        if (source_conn) PQfinish(source_conn);
+        for (PGconn* conn : target_conns) {
+            if (conn) PQfinish(conn);
+        }
+        throw;
+    }
+
+    PQfinish(source_conn);
+    for (PGconn* conn : target_conns) {
+        if (conn) PQfinish(conn);
+    }
+}
+
+void DatabaseMigrator::route_batch(RowBatch& batch, int key_column, const ShardConfig& shard) {
+    for (int row = 0; row < batch.rows(); row++) {
+        batch.set_route(row, shard.route(batch.is_null(row, key_column) ? nullptr : batch.value(row, key_column),
+            batch.length(row, key_column)));
+    }
+}
+
+std::vector<std::string> DatabaseMigrator::target_columns(const PGresult* res, const std::vector<ColumnMapping>& mapping) {
+    std::vector<std::string> columns;
+    for (int col = 0; col < PQnfields(res); col++)
+        columns.push_back(mapping.empty() ? std::string(PQfname(res, col)) : mapping[col].target);
+    return columns;
+}
+
+//      .  , 
+//    (),        
+struct VerifyJob {
+    std::string source_conn_str;
+    std::vector<std::string> target_conn_strs;
+    std::string source_query;
+    std::vector<std::string> target_queries;
+    bool ranged;
+    int chunks;
+    long long min_chunk_rows;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<KeyRange> queue;
+    int active = 0;
+    long long checked = 0;
+    std::vector<KeyRange> mismatches;
+    std::string error;
+};
+
+//   [from, to)     parts 
+static void split_range(long long from, long long to, int parts, std::deque<KeyRange>& out) {
+    unsigned long long span = (unsigned long long)to - (unsigned long long)from;
+    unsigned long long step = std::max(1ULL, (span + parts - 1) / parts);
+
+    for (unsigned long long offset = 0; offset < span; offset += step) {
+        KeyRange range = {};
+        range.from = (long long)((unsigned long long)from + offset);
+        range.to = (long long)((unsigned long long)from + std::min(span, offset + step));
+        out.push_back(range);
+    }
+}
+
+//       (  2^64);     
+static std::pair<long long, unsigned long long> read_range_hash(PGconn* conn) {
+    PGresult* res = PQgetResult(conn);
+    std::string error_msg = PQresultStatus(res) == PGRES_TUPLES_OK ? "" : PQerrorMessage(conn);
+    std::pair<long long, unsigned long long> result;
+    if (error_msg.empty())
+        result = { std::stoll(PQgetvalue(res, 0, 0)), std::stoull(PQgetvalue(res, 0, 1)) };
+    PQclear(res);
+
+    while ((res = PQgetResult(conn)) != nullptr)
+        PQclear(res);
+
+    if (!error_msg.empty())
+        throw std::runtime_error("Failed to compute range hash: " + error_msg);
+    return result;
+}
+
+static void verify_worker(VerifyJob& job) {
+    PGconn* source_conn = nullptr;
+    std::vector<PGconn*> target_conns;
+
+    try {
+        source_conn = PQconnectdb(job.source_conn_str.c_str());
+        if (PQstatus(source_conn) != CONNECTION_OK)
+            throw std::runtime_error("Failed to connect to source database");
+        for (const auto& conn_str : job.target_conn_strs) {
+            target_conns.push_back(PQconnectdb(conn_str.c_str()));
+            if (PQstatus(target_conns.back()) != CONNECTION_OK)
+                throw std::runtime_error("Failed to connect to target database");
+        }
+
+        while (true) {
+            KeyRange range;
+            {
+                std::unique_lock<std::mutex> lock(job.mtx);
+                job.cv.wait(lock, [&job] {
+                    return !job.queue.empty() || job.active == 0 || !job.error.empty(); });
+                if (job.queue.empty() || !job.error.empty())
+                    break;
+                range = job.queue.front();
+                job.queue.pop_front();
+                job.active++;
+            }
+
+            //      
+            std::string from = std::to_string(range.from);
+            std::string to = std::to_string(range.to);
+            const char* params[2] = { from.c_str(), to.c_str() };
+            int param_count = job.ranged ? 2 : 0;
+
+            if (!PQsendQueryParams(source_conn, job.source_query.c_str(), param_count, nullptr, params, nullptr, nullptr, 0))
+                throw std::runtime_error("Failed to send source hash query: " + std::string(PQerrorMessage(source_conn)));
+            for (size_t i = 0; i < target_conns.size(); i++) {
+                if (!PQsendQueryParams(target_conns[i], job.target_queries[i].c_str(), param_count, nullptr, params, nullptr, nullptr, 0))
+                    throw std::runtime_error("Failed to send target hash query: " + std::string(PQerrorMessage(target_conns[i])));
+            }
+
+            auto source_hash = read_range_hash(source_conn);
+            std::pair<long long, unsigned long long> target_hash = { 0, 0 };
+            for (PGconn* target_conn : target_conns) {
+                auto hash = read_range_hash(target_conn);
+                target_hash.first += hash.first;
+                target_hash.second += hash.second;
+            }
+            range.source_rows = source_hash.first;
+            range.target_rows = target_hash.first;
+
+            std::lock_guard<std::mutex> lock(job.mtx);
+            job.checked++;
+            if (source_hash != target_hash) {
+                //   ,      
+                long long rows = std::max(range.source_rows, range.target_rows);
+                if (job.ranged && rows > job.min_chunk_rows && range.to - range.from > 1)
+                    split_range(range.from, range.to, job.chunks, job.queue);
+                else
+                    job.mismatches.push_back(range);
+            }
+            job.active--;
+            job.cv.notify_all();
+        }
+    }
+    catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(job.mtx);
+        if (job.error.empty())
+            job.error = e.what();
+        job.cv.notify_all();
+    }
+
+    if (source_conn) PQfinish(source_conn);
+    for (PGconn* target_conn : target_conns)
+        PQfinish(target_conn);
+}
+
+//       ; NULL    
+static std::string shard_condition(const ShardConfig& shard, int number) {
+    std::string condition;
+    if (number > 0)
+        condition = shard.key + " >= " + std::to_string(shard.bounds[number - 1]);
+    if (number < (int)shard.bounds.size())
+        condition += (condition.empty() ? "" : " AND ") + shard.key + " < " + std::to_string(shard.bounds[number]);
+    if (number == 0)
+        condition = shard.key + " IS NULL OR " + condition;
+    return condition;
+}
+
+bool DatabaseMigrator::verify_table(const TableConfig& base_config, const TargetConfig& target) {
+    const TableConfig table_config = target.resolve(base_config);
+    if (table_config.exclude)
+        return true;
+
+    //          . 
+    //    (FNV-1a )       :
+    //        
+    const ShardConfig& shard = table_config.shard;
+    auto shard_name = std::find(shard.targets.begin(), shard.targets.end(), target.name);
+    int shard_number = shard_name == shard.targets.end() ? -1 : (int)(shard_name - shard.targets.begin());
+    std::vector<const TargetConfig*> checked_targets;
+    std::string source_where = table_config.where;
+    std::string label = target.name;
+
+    if (shard_number < 0 || shard.range) {
+        checked_targets.push_back(&target);
+        if (shard_number >= 0) {
+            std::string condition = shard_condition(shard, shard_number);
+            source_where = source_where.empty() ? condition : "(" + source_where + ") AND (" + condition + ")";
+        }
+    }
+    else if (shard_number == 0) {
+        label = "shards";
+        for (const auto& name : shard.targets) {
+            auto shard_target = std::find_if(targets.begin(), targets.end(),
+                [&](const TargetConfig& t) { return t.name == name; });
+            checked_targets.push_back(&*shard_target);
+            label += (name == shard.targets.front() ? " " : ", ") + name;
+        }
+    }
+    else {
+        return true;
+    }
+
+    const VerifyConfig& verify = table_config.verify;
+
+    //         ;
+    //     ,   ,   pushdown
+    std::vector<std::string> source_expressions;
+    for (const auto& column : map_columns(table_config))
+        source_expressions.push_back(convert_expression(column.source, column.type));
+
+    VerifyJob job;
+    job.source_conn_str = create_connection_string(source_db);
+    job.source_query = build_hash_query(table_config.source, source_expressions, verify.key, source_where);
+    job.ranged = !verify.key.empty();
+    job.chunks = verify.chunks;
+    job.min_chunk_rows = verify.min_chunk_rows;
+
+    //   -      
+    std::vector<std::pair<std::string, std::string>> sides = {
+        { job.source_conn_str, "SELECT min(" + verify.key + "), max(" + verify.key + ") FROM " + table_config.source +
+            (source_where.empty() ? "" : " WHERE " + source_where) }
+    };
+
+    for (const TargetConfig* checked_target : checked_targets) {
+        const TableConfig target_config = checked_target->resolve(base_config);
+        const std::string target_table = target_config.target.empty() ? target_config.source : target_config.target;
+        std::vector<std::string> target_expressions;
+        std::string target_key = verify.key;
+        for (const auto& column : map_columns(target_config)) {
+            target_expressions.push_back(column.target);
+            if (column.source == verify.key)
+                target_key = column.target;
+        }
+        if (target_expressions.size() != source_expressions.size())
+            throw std::runtime_error("Shards of table " + table_config.source + " migrate different columns and can't be verified together");
+
+        job.target_conn_strs.push_back(create_connection_string(checked_target->database));
+        job.target_queries.push_back(build_hash_query(target_table, target_expressions, target_key, ""));
+        sides.push_back({ job.target_conn_strs.back(),
+            "SELECT min(" + target_key + "), max(" + target_key + ") FROM " + target_table });
+    }
+
+    if (job.ranged) {
+        bool empty = true;
+        long long min_key = 0;
+        long long max_key = 0;
+
+        for (const auto& [conn_str, query] : sides) {
+            PGconn* conn = PQconnectdb(conn_str.c_str());
+            PGresult* res = PQexec(conn, query.c_str());
+            if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+                std::string error_msg = PQerrorMessage(conn);
+                PQclear(res);
+                PQfinish(conn);
+                throw std::runtime_error("Failed to read key bounds of " + table_config.source + ": " + error_msg);
+            }
+            if (!PQgetisnull(res, 0, 0)) {
+                long long low = std::stoll(PQgetvalue(res, 0, 0));
+                long long high = std::stoll(PQgetvalue(res, 0, 1));
+                min_key = empty ? low : std::min(min_key, low);
+                max_key = empty ? high : std::max(max_key, high);
+                empty = false;
+            }
+            PQclear(res);
+            PQfinish(conn);
+        }
+
+        if (empty) {
+            Logger::log(Logger::INFO, "DatabaseMigrator",
+                "Table " + table_config.source + " -> " + label + " verified: both sides are empty");
+            return true;
+        }
+        split_range(min_key, max_key + 1, verify.chunks, job.queue);
+    }
+    else {
+        job.queue.push_back(KeyRange{});
+    }
+
+    std::vector<std::thread> workers;
+    int worker_count = job.ranged ? std::min<int>(verify.parallel, (int)job.queue.size()) : 1;
+    for (int i = 0; i < worker_count; i++)
+        workers.emplace_back(verify_worker, std::ref(job));
+    for (auto& worker : workers)
+        worker.join();
+
+    if (!job.error.empty())
+        throw std::runtime_error("Error verifying table " + table_config.source + " in " + label + ": " + job.error);
+
+    std::sort(job.mismatches.begin(), job.mismatches.end(),
+        [](const KeyRange& a, const KeyRange& b) { return a.from < b.from; });
+
+    for (const auto& range : job.mismatches) {
+        std::string where = job.ranged ?
+            " keys [" + std::to_string(range.from) + ", " + std::to_string(range.to) + ")" : "";
+        Logger::log(Logger::WARN, "DatabaseMigrator",
+            "Table " + table_config.source + " -> " + label + where + " differ: source " +
+            std::to_string(range.source_rows) + " rows, target " + std::to_string(range.target_rows) + " rows");
+    }
+
+    Logger::log(Logger::INFO, "DatabaseMigrator",
+        "Table " + table_config.source + " -> " + label + " verified: " + std::to_string(job.checked) +
+        " ranges checked, " + std::to_string(job.mismatches.size()) + " differ");
+    return job.mismatches.empty();
+}
+
+std::string DatabaseMigrator::build_hash_query(const std::string& table, const std::vector<std::string>& expressions,
+    const std::string& key, const std::string& where) {
+    //   64  md5      ;   2^64 
+    //    ,    
+    std::string row_text = "t::text";
+    if (!expressions.empty()) {
+        row_text = "ROW(";
+        for (size_t i = 0; i < expressions.size(); i++) {
+            if (i > 0) row_text += ", ";
+            row_text += "(" + expressions[i] + ")::text";
+        }
+        row_text += ")::text";
+    }
+
+    std::stringstream query;
+    query << "SELECT count(*), mod(coalesce(sum(('x' || substr(md5(" << row_text
+        << "), 1, 16))::bit(64)::bigint::numeric), 0) + 18446744073709551616 * count(*), 18446744073709551616)::text FROM "
+        << table << " t";
+
+    std::vector<std::string> conditions;
+    if (!key.empty())
+        conditions.push_back(key + " >= $1 AND " + key + " < $2");
+    if (!where.empty())
+        conditions.push_back("(" + where + ")");
+
+    for (size_t i = 0; i < conditions.size(); i++)
+        query << (i == 0 ? " WHERE " : " AND ") << conditions[i];
+
+    return query.str();
+}
+
+void DatabaseMigrator::configure_loader_session(PGconn* conn, const BulkLoadConfig& bulk_load) {
+    if (!bulk_load.synchronous_commit)
+        execute_command(conn, "SET synchronous_commit = off");
+
+    //        (  )
+    if (bulk_load.disable_triggers)
+        execute_command(conn, "SET session_replication_role = replica");
+}
+
+//       ,   LIKE ... INCLUDING ALL,
+//     .        
+//  (     ),     staging  
+std::string DatabaseMigrator::create_staging_table(PGconn* conn, const std::string& target_table) {
+    std::vector<std::string> dependents = query_values(conn,
+        "SELECT 'foreign key ' || conname FROM pg_constraint "
+        "WHERE contype = 'f' AND $1::regclass IN (conrelid, confrelid) "
+        "UNION ALL SELECT 'trigger ' || tgname FROM pg_trigger WHERE tgrelid = $1::regclass AND NOT tgisinternal "
+        "UNION ALL SELECT DISTINCT 'view ' || r.ev_class::regclass::text FROM pg_depend d "
+        "JOIN pg_rewrite r ON r.oid = d.objid WHERE d.classid = 'pg_rewrite'::regclass "
+        "AND d.refobjid = $1::regclass AND r.ev_class <> $1::regclass "
+        "UNION ALL SELECT 'rule ' || rulename FROM pg_rewrite WHERE ev_class = $1::regclass "
+        "UNION ALL SELECT 'policy ' || polname FROM pg_policy WHERE polrelid = $1::regclass "
+        "UNION ALL SELECT 'row level security' FROM pg_class WHERE oid = $1::regclass AND relrowsecurity "
+        "UNION ALL SELECT 'privileges on column ' || attname FROM pg_attribute "
+        "WHERE attrelid = $1::regclass AND attacl IS NOT NULL "
+        "UNION ALL SELECT 'inheritance ' || inhparent::regclass::text || ' -> ' || inhrelid::regclass::text "
+        "FROM pg_inherits WHERE $1::regclass IN (inhrelid, inhparent) "
+        "UNION ALL SELECT 'publication ' || p.pubname FROM pg_publication_rel r "
+        "JOIN pg_publication p ON p.oid = r.prpubid WHERE r.prrelid = $1::regclass",
+        { target_table });
+
+    if (!dependents.empty()) {
+        std::string objects;
+        for (size_t i = 0; i < dependents.size(); i++)
+            objects += (i > 0 ? ", " : "") + dependents[i];
+        throw std::runtime_error("Table " + target_table + " can't be loaded through a staging table: " +
+            objects + " would be lost by the swap");
+    }
+
+    //    -   ,  OID    :  
+    // NAMEDATALEN      .    
+    std::vector<std::string> staging = query_values(conn,
+        "SELECT s.name, to_regclass(s.name) IS NOT NULL FROM pg_class c "
+        "JOIN pg_namespace n ON n.oid = c.relnamespace, "
+        "LATERAL (SELECT format('%I.%I', n.nspname, 'migrator_staging_' || c.oid || '_' || pg_backend_pid()) AS name) s "
+        "WHERE c.oid = $1::regclass",
+        { target_table });
+    if (staging.size() != 2)
+        throw std::runtime_error("Failed to find table " + target_table);
+    std::string staging_table = staging[0];
+    if (staging[1] == "t")
+        throw std::runtime_error("Staging table " + staging_table + " for " + target_table + " already exists");
+
+    execute_command(conn, "CREATE UNLOGGED TABLE " + staging_table +
+        " (LIKE " + target_table + " INCLUDING ALL)");
+
+    Logger::log(Logger::INFO, "DatabaseMigrator",
+        "Loading " + target_table + " through staging table " + staging_table);
+    return staging_table;
+}
+
+void DatabaseMigrator::swap_staging_table(PGconn* conn, const std::string& staging_table, const std::string& target_table) {
+    // RENAME TO    
+    std::vector<std::string> names = query_values(conn,
+        "SELECT format('%I', c.relname), format('%I', r.name), format('%I.%I', n.nspname, r.name), "
+        "to_regclass(format('%I.%I', n.nspname, r.name)) IS NOT NULL FROM pg_class c "
+        "JOIN pg_namespace n ON n.oid = c.relnamespace, "
+        "LATERAL (SELECT 'migrator_retired_' || c.oid || '_' || pg_backend_pid() AS name) r "
+        "WHERE c.oid = $1::regclass",
+        { target_table });
+    if (names.size() != 4)
+        throw std::runtime_error("Failed to find table " + target_table);
+    const std::string& target_name = names[0];
+    const std::string& retired_name = names[1];
+    const std::string& retired_table = names[2];
+    if (names[3] == "t")
+        throw std::runtime_error("Table " + retired_table + " for retired " + target_table + " already exists");
+
+    //       ,     
+    execute_command(conn, "ALTER TABLE " + staging_table + " SET LOGGED");
+
+    execute_command(conn, "BEGIN");
+    execute_command(conn, "LOCK TABLE " + target_table + " IN ACCESS EXCLUSIVE MODE");
+
+    //         .   :
+    //        
+    for (const auto& command : query_values(conn,
+        "SELECT format('ALTER TABLE %s OWNER TO %I', $2::text, pg_get_userbyid(relowner)) "
+        "FROM pg_class WHERE oid = $1::regclass", { target_table, staging_table }))
+        execute_command(conn, command);
+
+    for (const auto& command : query_values(conn,
+        "SELECT DISTINCT format('REVOKE ALL ON %s FROM %s', $1::text, "
+        "CASE WHEN a.grantee = 0 THEN 'PUBLIC' ELSE quote_ident(pg_get_userbyid(a.grantee)) END) "
+        "FROM pg_class c, aclexplode(c.relacl) a WHERE c.oid = $1::regclass AND a.grantee <> c.relowner",
+        { staging_table }))
+        execute_command(conn, command);
+
+    for (const auto& command : query_values(conn,
+        "SELECT format('GRANT %s ON %s TO %s%s', a.privilege_type, $2::text, "
+        "CASE WHEN a.grantee = 0 THEN 'PUBLIC' ELSE quote_ident(pg_get_userbyid(a.grantee)) END, "
+        "CASE WHEN a.is_grantable THEN ' WITH GRANT OPTION' ELSE '' END) "
+        "FROM pg_class c, aclexplode(c.relacl) a WHERE c.oid = $1::regclass AND a.grantee <> c.relowner",
+        { target_table, staging_table }))
+        execute_command(conn, command);
+
+    //  serial-    ,     
+    std::vector<std::string> sequences = query_values(conn,
+        "SELECT s.oid::regclass::text, quote_ident(a.attname) FROM pg_class s "
+        "JOIN pg_depend d ON d.objid = s.oid AND d.deptype = 'a' "
+        "JOIN pg_attribute a ON a.attrelid = d.refobjid AND a.attnum = d.refobjsubid "
+        "WHERE s.relkind = 'S' AND d.refobjid = $1::regclass",
+        { target_table });
+    for (size_t i = 0; i + 1 < sequences.size(); i += 2)
+        execute_command(conn, "ALTER SEQUENCE " + sequences[i] + " OWNED BY " + staging_table + "." + sequences[i + 1]);
+
+    execute_command(conn, "ALTER TABLE " + target_table + " RENAME TO " + retired_name);
+    execute_command(conn, "ALTER TABLE " + staging_table + " RENAME TO " + target_name);
+    execute_command(conn, "DROP TABLE " + retired_table);
+    execute_command(conn, "COMMIT");
+
+    Logger::log(Logger::INFO, "DatabaseMigrator",
+        "Staging table swapped in as " + target_table);
+}
+
+void DatabaseMigrator::execute_command(PGconn* conn, const std::string& command) {
+    PGresult* res = PQexec(conn, command.c_str());
+    if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+        std::string error_msg = PQerrorMessage(conn);
+        PQclear(res);
+        throw std::runtime_error("Failed to execute '" + command + "': " + error_msg);
+    }
+    PQclear(res);
+}
+
+std::string DatabaseMigrator::generate_ddl(const TableConfig& table_config) {
+    std::stringstream ddl;
+    ddl << "CREATE TABLE IF NOT EXISTS "
+        << (table_config.target.empty() ? table_config.source : table_config.target)
+        << " (\n";
+
+    std::vector<std::string> columns;
+
+    for (const auto& col : table_config.columns) {
         if (col.second.find("exclude") != col.second.end() &&
             col.second.at("exclude") == "true") {
             continue;
@@ -313,6 +2444,74 @@ std::string DatabaseMigrator::generate_ddl(const TableConfig& table_config) {
     return ddl.str();
 }
 
+std::vector<ColumnMapping> DatabaseMigrator::map_columns(const TableConfig& table_config) {
+    std::vector<ColumnMapping> mapping;
+
+    for (const auto& col : table_config.columns) {
+        if (col.second.find("exclude") != col.second.end() &&
+            col.second.at("exclude") == "true") {
+            continue;
+        }
+
+        ColumnMapping column;
+        column.source = col.first;
+        column.target = col.second.find("target_name") != col.second.end() ?
+            col.second.at("target_name") : col.first;
+        column.type = col.second.find("type") != col.second.end() ?
+            col.second.at("type") : "";
+        column.expression = col.first;
+
+        //   convert_value  .    BASE64:
+        //  VARCHAR  BIGINT      
+        column.client = column.type == "BASE64" || column.type == "VARCHAR" || column.type == "BIGINT";
+        if (table_config.pushdown && column.type == "BASE64") {
+            column.expression = convert_expression(col.first, column.type);
+            column.client = false;
+        }
+
+        mapping.push_back(column);
+    }
+
+    return mapping;
+}
+
+std::string DatabaseMigrator::build_source_query(const TableConfig& table_config, const std::vector<ColumnMapping>& mapping) {
+    std::stringstream query;
+    query << "SELECT ";
+
+    if (mapping.empty()) {
+        query << "*";
+    }
+    else {
+        const LargeValueConfig& large_values = table_config.large_values;
+        for (size_t i = 0; i < mapping.size(); i++) {
+            if (i > 0) query << ", ";
+
+            //    :      
+            if (std::find(large_values.columns.begin(), large_values.columns.end(), mapping[i].source) !=
+                large_values.columns.end()) {
+                query << "CASE WHEN octet_length(" << mapping[i].source << ") > " << large_values.threshold
+                    << " THEN NULL ELSE " << mapping[i].expression << " END";
+                continue;
+            }
+            query << mapping[i].expression;
+        }
+    }
+
+    query << " FROM " << table_config.source_relation();
+    if (!table_config.where.empty())
+        query << " WHERE " << table_config.where;
+
+    return query.str();
+}
+
+std::string DatabaseMigrator::build_count_query(const TableConfig& table_config) {
+    std::string query = "SELECT COUNT(*) FROM " + table_config.source_relation();
+    if (!table_config.where.empty())
+        query += " WHERE " + table_config.where;
+    return query;
+}
+
 std::string DatabaseMigrator::convert_value(const std::string& value, const std::string& type) {
     if (type == "BASE64") {
         return Base64::encode(value);
@@ -342,4 +2541,23 @@ std::string DatabaseMigrator::convert_value(const std::string& value, const std:
     }
 
     return value;
+}
+
+//  SQL,    ,  convert_value
+std::string DatabaseMigrator::convert_expression(const std::string& expression, const std::string& type) {
+    std::string text = "(" + expression + ")::text";
+    if (type == "BASE64") {
+        // encode()      76  -   
+        return "translate(encode(convert_to(" + text + ", 'UTF8'), 'base64'), E'\\n', '')";
+    }
+    else if (type == "VARCHAR") {
+        return "CASE WHEN strpos(" + text + ", '(') > 0 AND strpos(substr(" + text + ", strpos(" + text +
+            ", '(')), ')') > 0 THEN left(" + text + ", strpos(" + text + ", '(') - 1) ELSE " + text + " END";
+    }
+    else if (type == "BIGINT") {
+        return "CASE WHEN left(" + text + ", 1) = '\\' AND right(" + text + ", 1) = '\\' THEN substr(" +
+            text + ", 2, greatest(length(" + text + ") - 2, 0)) ELSE " + text + " END";
+    }
+
+    return expression;
 }
\ No newline at end of file
@@ -3,8 +3,10 @@
 *        : 
 *  .     config-,  
 *  json  :
-*   1.      PostgreSQL  
-*   2.      PostgreSQL  
+*   1.      PostgreSQL   ( 
+*      ,  DatabaseOperator::backup,  )
+*   2.      PostgreSQL   (  
+*        -      )
 *   3.        
 */
 
@@ -19,7 +21,10 @@
 #include <map>
 #include "external/json.hpp"
 #include <libpq-fe.h>
-#include "Logger.h"
+#include "logger.h"
+#include "migration_pipeline.h"
+#include "adaptive_tuner.h"
+#include "backup_io.h"
 
 using json = nlohmann::json;
 
@@ -35,32 +40,229 @@ struct DatabaseConfig {
     DatabaseConfig& operator=(const json& j);
 };
 
+//       ( "bulk_load" )
+struct BulkLoadConfig {
+    bool enabled;
+    long long commit_rows;      //    N  (0 -  )
+    long long commit_bytes;     //    N  (0 -  )
+    bool staging;               //   UNLOGGED-     
+    bool disable_triggers;      // session_replication_role = replica   
+    bool synchronous_commit;    //  synchronous_commit   
+
+    BulkLoadConfig();
+    BulkLoadConfig& operator=(const json& j);
+    bool commit_due(long long rows, long long bytes) const;
+};
+
+//      ( "upsert" )
+struct UpsertConfig {
+    bool enabled;
+    std::vector<std::string> conflict_key;  //     ON CONFLICT
+    bool update;                // DO UPDATE (true)  DO NOTHING (false)
+    int batch_rows;             //      INSERT
+    int pipeline_depth;         //  ,   
+
+    UpsertConfig();
+    UpsertConfig& operator=(const json& j);
+};
+
+//     ( "pipeline" config-)
+struct PipelineConfig {
+    int fetch_rows;             //  ,      FETCH
+    long long memory_limit;     //       , 
+    int target_buffer;          //  ,       
+
+    PipelineConfig();
+    PipelineConfig& operator=(const json& j);
+};
+
+//       ( "tuning" config-)
+struct TuningConfig {
+    bool enabled;
+    TuningRange fetch_rows;     //     FETCH
+    TuningRange commit_rows;    //      bulk_load
+    TuningRange copy_buffer;    //    COPY,  libpq  , 
+    int window;                 //  ,    
+
+    TuningConfig();
+    TuningConfig& operator=(const json& j);
+};
+
+//         ( "verify" )
+struct VerifyConfig {
+    std::string key;            //        
+    int chunks;                 //     
+    long long min_chunk_rows;   //  ,      
+    int parallel;               //   ,   
+
+    VerifyConfig();
+    VerifyConfig& operator=(const json& j);
+};
+
+//       -  ( "shard" )
+struct ShardConfig {
+    std::string key;                    //   ,   
+    bool range;                         //    (true)    (false)
+    std::vector<std::string> targets;   //       
+    std::vector<long long> bounds;      //  ( )   ,  
+
+    ShardConfig();
+    ShardConfig& operator=(const json& j);
+    bool enabled() const;
+    int route(const char* value, int length) const;
+};
+
+//     bytea/text ( "large_values" )
+struct LargeValueConfig {
+    std::vector<std::string> columns;   //       
+    std::vector<std::string> key;       //   ,   
+    long long threshold;                //   threshold    
+    long long chunk_size;               //   , 
+
+    LargeValueConfig();
+    LargeValueConfig& operator=(const json& j);
+    bool enabled() const;
+};
+
+//    pg_largeobject ( "large_objects" config-)
+struct LargeObjectConfig {
+    bool enabled;
+    long long chunk_size;               //    lo_read/lo_write, 
+
+    LargeObjectConfig();
+    LargeObjectConfig& operator=(const json& j);
+};
+
+//   [from, to)        
+struct KeyRange {
+    long long from;
+    long long to;
+    long long source_rows;
+    long long target_rows;
+};
+
+// ,      
+struct ColumnMapping {
+    std::string source;
+    std::string target;
+    std::string type;
+    std::string expression;     //       
+    bool client;                //    (convert_value)
+};
+
 struct TableConfig {
     std::string source;
     std::string target;
     bool exclude;
     bool create_if_missing;
+    std::string where;          //    
+    bool pushdown;              //      
     std::map<std::string, std::map<std::string, std::string>> columns;
+    BulkLoadConfig bulk_load;
+    UpsertConfig upsert;
+    VerifyConfig verify;
+    ShardConfig shard;
+    LargeValueConfig large_values;
+    std::string relation;       //       source (   )
 
     TableConfig(const json& j);
     TableConfig& operator=(const json& j);
+    std::string source_relation() const;
 };
 
+//      ( "source_backup"  "source_database").
+//  COPY        staging,
+//    ,    
+struct BackupSourceConfig {
+    std::string file;                   //       
+    std::string repository;             //  ,      
+    std::string staging;                //       (  - )
+    int threads;                        //  ,  
+    BackupIOConfig io;
+
+    BackupSourceConfig();
+    BackupSourceConfig& operator=(const json& j);
+    bool enabled() const;
+};
+
+//       INSERT ... SELECT ( "offload"  ).
+//      ,    -    ,
+//  -   link,    
+struct OffloadConfig {
+    bool enabled;                       //   link (postgres_fdw  dblink)
+    bool detect;                        // ,      
+    std::string link;                   // "postgres_fdw", "dblink"  
+    std::string server;                 //    ,    
+    std::string schema;                 //       postgres_fdw
+
+    OffloadConfig();
+    OffloadConfig& operator=(const json& j);
+};
+
+//   (  "target_database")    
+struct TargetConfig {
+    std::string name;
+    DatabaseConfig database;
+    OffloadConfig offload;
+    std::map<std::string, json> tables;     //   ->   TableConfig
+
+    TargetConfig& operator=(const json& j);
+    TableConfig resolve(const TableConfig& table_config) const;
+};
+
+struct TargetLoad;
+struct ManifestTable;
+class BackupManifest;
+
 class DatabaseMigrator {
 private:
     static ProgressCallback callback_;
 
     DatabaseConfig source_db;
-    DatabaseConfig target_db;
+    BackupSourceConfig source_backup;
+    std::vector<TargetConfig> targets;
+    std::vector<bool> failed_targets;       // ,     
+    std::vector<int> colocated_targets;     //    -   (1),  (0),   (-1)
     std::vector<TableConfig> tables;
+    PipelineConfig pipeline;
+    LargeObjectConfig large_objects;
+    TuningConfig tuning;
     bool isConfigInitialized = false;
 
     void load_config();
     std::string create_connection_string(const DatabaseConfig& config);
     void migrate();
     void migrate_table(const TableConfig& table_config);
+    void migrate_from_backup();
+    void stage_backup_table(const BackupManifest& manifest, const ManifestTable& table, const std::string& staged_table);
+    void open_target(TargetLoad& load, PGconn* source_conn, const std::vector<ColumnMapping>& mapping,
+        const std::vector<std::string>& columns);
+    void create_writer(TargetLoad& load, const std::vector<Oid>& types, bool binary);
+    std::string build_offload_query(TargetLoad& load, PGconn* source_conn, const std::vector<ColumnMapping>& mapping,
+        const std::vector<std::string>& columns);
+    bool is_colocated(size_t target, PGconn* source_conn, PGconn* target_conn);
+    void run_offload(TargetLoad& load);
+    void fail_target(TargetLoad& load, const std::string& error);
+    void migrate_large_values(PGconn* source_conn, const TableConfig& table_config,
+        const std::vector<TargetLoad*>& loads);
+    void migrate_large_objects();
+    void fetch_batch(PGconn* conn, const std::string& fetch_sql, bool binary, RowBatch& batch);
+    void convert_batch(RowBatch& batch, RowBatch& scratch, const std::vector<ColumnMapping>& mapping);
+    void route_batch(RowBatch& batch, int key_column, const ShardConfig& shard);
+    std::vector<std::string> target_columns(const PGresult* res, const std::vector<ColumnMapping>& mapping);
+    bool verify_table(const TableConfig& table_config, const TargetConfig& target);
+    std::string build_hash_query(const std::string& table, const std::vector<std::string>& expressions,
+        const std::string& key, const std::string& where);
+    void configure_loader_session(PGconn* conn, const BulkLoadConfig& bulk_load);
+    std::string create_staging_table(PGconn* conn, const std::string& target_table);
+    void swap_staging_table(PGconn* conn, const std::string& staging_table, const std::string& target_table);
+    void execute_command(PGconn* conn, const std::string& command);
     std::string generate_ddl(const TableConfig& table_config);
+    std::vector<ColumnMapping> map_columns(const TableConfig& table_config);
+    std::string build_source_query(const TableConfig& table_config, const std::vector<ColumnMapping>& mapping);
+    std::string build_count_query(const TableConfig& table_config);
     std::string convert_value(const std::string& value, const std::string& type);
+    std::string convert_expression(const std::string& expression, const std::string& type);
 
 public:
     std::string config_path;
@@ -69,6 +271,7 @@ public:
 
     DatabaseMigrator(std::string config_path);
     bool execute_migration();
+    bool execute_verification();
 };
 
 #endif // DATABASE_MIGRATOR_H
\ No newline at end of file
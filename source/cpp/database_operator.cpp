@@ -2,6 +2,8 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include "backup_io.h"
+#include "chunk_store.h"
 
 DatabaseOperator::DatabaseOperator()
     : conn_(nullptr), connected_(false) {
@@ -96,6 +98,8 @@ bool DatabaseOperator::backup(const std::string& json_config, const std::string&
     }
 
     std::vector<std::string> tables_to_backup;
+    BackupIOConfig io_config;
+    ChunkStoreConfig repository;
 
     //   config-,     
     if (!json_config.empty()) {
@@ -112,6 +116,10 @@ bool DatabaseOperator::backup(const std::string& json_config, const std::string&
             for (const auto& table : config["tables"]) {
                 tables_to_backup.push_back(table);
             }
+            if (config.contains("io"))
+                io_config = config["io"];
+            if (config.contains("repository"))
+                repository = config["repository"];
         }
         catch (const std::exception& e) {
             Logger::log(Logger::ERROR, "DatabaseOperator",
@@ -138,53 +146,170 @@ bool DatabaseOperator::backup(const std::string& json_config, const std::string&
         system(mkdir_cmd.c_str());
     }
 
-    std::ofstream backup_file(out_file, std::ios::binary);
-    if (!backup_file.is_open()) {
-        Logger::log(Logger::ERROR, "DatabaseOperator",
-            "Failed to open backup file: " + out_file);
-        return false;
+    //    out_file -  ,   COPY 
+    //   ,      .
+    //       "<out_file>.manifest"  
+    //    -       
+    std::unique_ptr<BackupWriter> backup_file;
+    std::unique_ptr<ChunkStore> store;
+    std::unique_ptr<ChunkSplitter> splitter;
+    BackupManifest manifest;
+    long long offset = 0;
+    if (repository.enabled()) {
+        store.reset(new ChunkStore(repository.path));
+        splitter.reset(new ChunkSplitter(*store, repository));
+        manifest.repository = repository.path;
     }
+    else {
+        manifest.format = "file";
+        manifest.file = out_file;
+        backup_file.reset(new BackupWriter(out_file, io_config));
+        if (!backup_file->is_open()) {
+            Logger::log(Logger::ERROR, "DatabaseOperator",
+                "Failed to open backup file: " + out_file);
+            return false;
+        }
+    }
+
+    //        ;
+    //     ,  libpq   
+    try {
+        for (const auto& table : tables_to_backup) {
+            //     COPY:    
+            ManifestTable described;
+            described.name = table;
+            described.offset = offset;
+            const char* params[1] = { table.c_str() };
+            PGresult* res = PQexecParams(conn_,
+                "SELECT attname, format_type(atttypid, atttypmod) FROM pg_attribute "
+                "WHERE attrelid = $1::regclass AND attnum > 0 AND NOT attisdropped AND attgenerated = '' "
+                "ORDER BY attnum", 1, nullptr, params, nullptr, nullptr, 0);
+            if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+                Logger::log(Logger::ERROR, "DatabaseOperator",
+                    "Failed to backup table: " + table + ": " + PQerrorMessage(conn_));
+                PQclear(res);
+                return false;
+            }
+            for (int row = 0; row < PQntuples(res); row++)
+                described.columns.push_back({ PQgetvalue(res, row, 0), PQgetvalue(res, row, 1) });
+            PQclear(res);
+
+            std::string query = "COPY " + table + " TO STDOUT BINARY";
+            res = PQexec(conn_, query.c_str());
 
-    //        
-    for (const auto& table : tables_to_backup) {
-        std::string query = "COPY " + table + " TO STDOUT BINARY";
-        PGresult* res = PQexec(conn_, query.c_str());
+            if (PQresultStatus(res) != PGRES_COPY_OUT) {
+                Logger::log(Logger::ERROR, "DatabaseOperator",
+                    "Failed to backup table: " + table);
+                PQclear(res);
+                return false;
+            }
+            PQclear(res);
 
-        if (PQresultStatus(res) == PGRES_COPY_OUT) {
-            char* buffer = new char[8192];
+            if (splitter)
+                splitter->begin(table);
+
+            char* buffer = nullptr;
             int len;
-            while ((len = PQgetCopyData(conn_, &buffer, 8192)) > 0) {
-                backup_file.write(buffer, len);
+            while ((len = PQgetCopyData(conn_, &buffer, 0)) > 0) {
+                if (splitter)
+                    splitter->write(buffer, len);
+                else
+                    backup_file->write(buffer, len);
+                offset += len;
+                PQfreemem(buffer);
             }
-            delete[] buffer;
-            PQputCopyEnd(conn_, NULL);
+
+            res = PQgetResult(conn_);
+            bool copied = len == -1 && PQresultStatus(res) == PGRES_COMMAND_OK;
             PQclear(res);
+            while ((res = PQgetResult(conn_)) != nullptr)
+                PQclear(res);
+
+            if (!copied) {
+                Logger::log(Logger::ERROR, "DatabaseOperator",
+                    "Failed to backup table: " + table + ": " + PQerrorMessage(conn_));
+                return false;
+            }
+
+            if (splitter) {
+                ManifestTable stored = splitter->end();
+                stored.columns = described.columns;
+                manifest.tables.push_back(stored);
+            }
+            else {
+                described.size = offset - described.offset;
+                manifest.tables.push_back(described);
+            }
+        }
+
+        if (splitter) {
+            manifest.save(out_file);
+            Logger::log(Logger::INFO, "DatabaseOperator",
+                "Backup repository " + repository.path + ": " + std::to_string(splitter->stored_chunks()) + " of " +
+                std::to_string(splitter->total_chunks()) + " chunks stored, " + std::to_string(splitter->stored_bytes()) +
+                " of " + std::to_string(splitter->total_bytes()) + " bytes written");
         }
         else {
+            backup_file->close();
+            manifest.save(out_file + ".manifest");
+            if (!backup_file->tuning_report().empty())
+                Logger::log(Logger::INFO, "DatabaseOperator", "Tuned settings: " + backup_file->tuning_report());
+        }
+    }
+    catch (const std::exception& e) {
+        Logger::log(Logger::ERROR, "DatabaseOperator",
+            "Failed to write backup file: " + std::string(e.what()));
+        return false;
+    }
+
+    //  :         keep.
+    // ,    ,   -     
+    if (store && repository.prune) {
+        try {
+            std::unordered_set<std::string> referenced;
+            std::vector<BackupManifest> kept(1, manifest);
+            for (const auto& path : repository.keep) {
+                kept.emplace_back();
+                kept.back().load(path);
+                if (kept.back().format != "chunks")
+                    throw std::runtime_error(path + " isn't a backup repository manifest");
+            }
+            for (const auto& backup : kept) {
+                for (const auto& table : backup.tables) {
+                    for (const auto& chunk : table.chunks)
+                        referenced.insert(chunk.hash);
+                }
+            }
+
+            long long removed_bytes = 0;
+            long long removed = store->prune(referenced, removed_bytes);
+            Logger::log(Logger::INFO, "DatabaseOperator",
+                "Backup repository " + repository.path + " pruned: " + std::to_string(removed) + " chunks, " +
+                std::to_string(removed_bytes) + " bytes removed");
+        }
+        catch (const std::exception& e) {
             Logger::log(Logger::ERROR, "DatabaseOperator",
-                "Failed to backup table: " + table);
-            PQclear(res);
-            backup_file.close();
+                "Backup saved to " + out_file + ", but the repository wasn't pruned: " + std::string(e.what()));
             return false;
         }
     }
 
-    backup_file.close();
     Logger::log(Logger::INFO, "DatabaseOperator",
         "Backup completed successfully to: " + out_file);
     return true;
 }
 
-bool DatabaseOperator::restore(const std::string& in_file, const std::string& json_config) {
+bool DatabaseOperator::restore(const std::string& json_config, const std::string& in_file) {
     if (!connected_) {
         Logger::log(Logger::ERROR, "DatabaseOperator", "Not connected to database");
         return false;
     }
 
     std::vector<std::string> tables_to_restore;
-    std::ifstream backup_file(in_file, std::ios::binary);
+    BackupIOConfig io_config;
+    ChunkStoreConfig repository;
 
-    //   config-   
+    //   config-   
     if (!json_config.empty()) {
         std::ifstream config_file(json_config);
         if (!config_file.is_open()) {
@@ -199,6 +324,10 @@ bool DatabaseOperator::restore(const std::string& in_file, const std::string& js
             for (const auto& table : config["tables"]) {
                 tables_to_restore.push_back(table);
             }
+            if (config.contains("io"))
+                io_config = config["io"];
+            if (config.contains("repository"))
+                repository = config["repository"];
         }
         catch (const std::exception& e) {
             Logger::log(Logger::ERROR, "DatabaseOperator",
@@ -206,44 +335,183 @@ bool DatabaseOperator::restore(const std::string& in_file, const std::string& js
             return false;
         }
     }
-    else {
-        //  -  
-        if (!backup_file.is_open()) {
+
+    //   :      ,
+    //   ;     
+    if (BackupManifest::is_manifest(in_file)) {
+        try {
+            BackupManifest manifest;
+            manifest.load(in_file);
+            ChunkStore store(repository.enabled() ? repository.path : manifest.repository);
+
+            if (tables_to_restore.empty()) {
+                for (const auto& table : manifest.tables)
+                    tables_to_restore.push_back(table.name);
+            }
+
+            for (const auto& table : tables_to_restore) {
+                const ManifestTable* stored = manifest.find(table);
+                if (!stored)
+                    throw std::runtime_error("Table " + table + " isn't in the backup");
+
+                ChunkStreamReader reader(store, stored->chunks, repository.threads);
+                if (!copy_in(table, [&](const char*& data) { return reader.next(data); }))
+                    return false;
+            }
+        }
+        catch (const std::exception& e) {
+            Logger::log(Logger::ERROR, "DatabaseOperator",
+                "Failed to read backup repository: " + std::string(e.what()));
+            return false;
+        }
+
+        Logger::log(Logger::INFO, "DatabaseOperator",
+            "Restore completed successfully from: " + in_file);
+        return true;
+    }
+
+    //  "<in_file>.manifest",    ,  
+    //   ;       
+    BackupManifest manifest;
+    bool described = false;
+    if (std::ifstream(in_file + ".manifest").is_open()) {
+        try {
+            manifest.load(in_file + ".manifest");
+            described = true;
+        }
+        catch (const std::exception& e) {
             Logger::log(Logger::ERROR, "DatabaseOperator",
-                "Failed to open backup file: " + in_file);
+                "Failed to read backup manifest: " + std::string(e.what()));
             return false;
         }
+        if (tables_to_restore.empty()) {
+            for (const auto& table : manifest.tables)
+                tables_to_restore.push_back(table.name);
+        }
+    }
+    if (tables_to_restore.empty()) {
+        Logger::log(Logger::ERROR, "DatabaseOperator",
+            "No tables to restore: " + in_file + ".manifest is missing and the config has no tables");
+        return false;
     }
 
-    //   
-    for (const auto& table : tables_to_restore) {
-        std::string query = "COPY " + table + " FROM STDIN BINARY";
-        PGresult* res = PQexec(conn_, query.c_str());
+    if (described) {
+        std::string tuning;
+        try {
+            for (const auto& table : tables_to_restore) {
+                const ManifestTable* stored = manifest.find(table);
+                if (!stored)
+                    throw std::runtime_error("Table " + table + " isn't in the backup");
 
-        if (PQresultStatus(res) == PGRES_COPY_IN) {
-            char* buffer = new char[8192];
-            int len;
-            while ((len = (int)backup_file.readsome(buffer, 8192)) > 0) {
-                PQputCopyData(conn_, buffer, len);
+                BackupReader reader(in_file, io_config, stored->offset, stored->size);
+                if (!reader.is_open())
+                    throw std::runtime_error("Failed to open backup file: " + in_file);
+                if (!copy_in(table, [&](const char*& data) { return reader.next(data); }))
+                    return false;
+                tuning = reader.tuning_report();
             }
-            delete[] buffer;
-            PQputCopyEnd(conn_, NULL);
         }
-        else {
+        catch (const std::exception& e) {
             Logger::log(Logger::ERROR, "DatabaseOperator",
-                "Failed to restore table: " + table);
-            PQclear(res);
-            backup_file.close();
+                "Failed to read backup file: " + std::string(e.what()));
             return false;
         }
+
+        if (!tuning.empty())
+            Logger::log(Logger::INFO, "DatabaseOperator", "Tuned settings: " + tuning);
+        Logger::log(Logger::INFO, "DatabaseOperator",
+            "Restore completed successfully from: " + in_file);
+        return true;
+    }
+
+    BackupReader backup_file(in_file, io_config);
+    if (!backup_file.is_open()) {
+        Logger::log(Logger::ERROR, "DatabaseOperator",
+            "Failed to open backup file: " + in_file);
+        return false;
     }
 
-    backup_file.close();
+    //   :    ,  
+    // COPY       
+    try {
+        CopyStreamScanner scanner;
+        const char* chunk = nullptr;
+        size_t chunk_len = 0;
+
+        for (const auto& table : tables_to_restore) {
+            scanner.reset();
+            bool restored = copy_in(table, [&](const char*& data) -> size_t {
+                if (scanner.done())
+                    return 0;
+                if (chunk_len == 0 && (chunk_len = backup_file.next(chunk)) == 0)
+                    throw std::runtime_error("Unexpected end of backup file while restoring " + table);
+
+                size_t len = scanner.feed(chunk, chunk_len);
+                data = chunk;
+                chunk += len;
+                chunk_len -= len;
+                return len;
+            });
+            if (!restored)
+                return false;
+        }
+    }
+    catch (const std::exception& e) {
+        Logger::log(Logger::ERROR, "DatabaseOperator",
+            "Failed to read backup file: " + std::string(e.what()));
+        return false;
+    }
+
+    if (!backup_file.tuning_report().empty())
+        Logger::log(Logger::INFO, "DatabaseOperator", "Tuned settings: " + backup_file.tuning_report());
     Logger::log(Logger::INFO, "DatabaseOperator",
         "Restore completed successfully from: " + in_file);
     return true;
 }
 
+//   COPY BINARY  ; next     (0 - ).
+//     COPY ,   
+bool DatabaseOperator::copy_in(const std::string& table, const std::function<size_t(const char*&)>& next) {
+    std::string query = "COPY " + table + " FROM STDIN BINARY";
+    PGresult* res = PQexec(conn_, query.c_str());
+
+    if (PQresultStatus(res) != PGRES_COPY_IN) {
+        Logger::log(Logger::ERROR, "DatabaseOperator",
+            "Failed to restore table: " + table);
+        PQclear(res);
+        return false;
+    }
+    PQclear(res);
+
+    bool sent = true;
+    try {
+        const char* data = nullptr;
+        size_t len;
+        while (sent && (len = next(data)) > 0)
+            sent = PQputCopyData(conn_, data, (int)len) == 1;
+    }
+    catch (const std::exception&) {
+        PQputCopyEnd(conn_, "restore aborted");
+        while ((res = PQgetResult(conn_)) != nullptr)
+            PQclear(res);
+        throw;
+    }
+
+    PQputCopyEnd(conn_, sent ? NULL : "restore aborted");
+    res = PQgetResult(conn_);
+    bool restored = sent && PQresultStatus(res) == PGRES_COMMAND_OK;
+    PQclear(res);
+    while ((res = PQgetResult(conn_)) != nullptr)
+        PQclear(res);
+
+    if (!restored) {
+        Logger::log(Logger::ERROR, "DatabaseOperator",
+            "Failed to restore table: " + table + ": " + PQerrorMessage(conn_));
+        return false;
+    }
+    return true;
+}
+
 void DatabaseOperator::exit() {
     disconnect();
     Logger::log(Logger::INFO, "DatabaseOperator", "DatabaseOperator exited");
@@ -14,9 +14,10 @@
 #define DATABASE_OPERATOR_H
 
 #include <string>
+#include <functional>
 #include <libpq-fe.h>
 #include "external/json.hpp"
-#include "Logger.h"
+#include "logger.h"
 
 using json = nlohmann::json;
 
@@ -28,6 +29,7 @@ private:
 
     void handle_error(const std::string& operation);
     void execute_query(const std::string& query);
+    bool copy_in(const std::string& table, const std::function<size_t(const char*&)>& next);
 
 public:
     DatabaseOperator();
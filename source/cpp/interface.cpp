@@ -34,6 +34,10 @@ DLL_API bool ExecuteMigration(DatabaseMigrator* migrator) {
     return migrator->execute_migration();
 }
 
+DLL_API bool VerifyMigration(DatabaseMigrator* migrator) {
+    return migrator->execute_verification();
+}
+
 DLL_API DatabaseOperator* ConnectDatabase(const char* connection_string) {
     DatabaseOperator* operator_ = new DatabaseOperator();
     if (operator_->connect(connection_string))
@@ -23,6 +23,8 @@ DLL_API void RegisterMigrationProgressCallback(ProgressCallback);
 DLL_API DatabaseMigrator* InitializeDatabaseMigrator(const char*);
 // Запуск миграции на основе загруженного config-файла
 DLL_API bool ExecuteMigration(DatabaseMigrator*);
+// Проверка совпадения целевой БД с исходной по загруженному config-файлу
+DLL_API bool VerifyMigration(DatabaseMigrator*);
 
 // Подключение к БД в ручном режиме
 DLL_API DatabaseOperator* ConnectDatabase(const char*);
@@ -0,0 +1,234 @@
+#include "large_value.h"
+#include <libpq/libpq-fs.h>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+
+// OID ,     
+static const Oid BYTEA_OID = 17;
+static const Oid TEXT_OID = 25;
+static const Oid BPCHAR_OID = 1042;
+static const Oid VARCHAR_OID = 1043;
+
+static const char BASE64_TABLE[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void encode_triple(const unsigned char* in, std::string& out) {
+    out += BASE64_TABLE[in[0] >> 2];
+    out += BASE64_TABLE[((in[0] & 0x03) << 4) | (in[1] >> 4)];
+    out += BASE64_TABLE[((in[1] & 0x0F) << 2) | (in[2] >> 6)];
+    out += BASE64_TABLE[in[2] & 0x3F];
+}
+
+Base64Stream::Base64Stream()
+    : carry_length_(0) {
+}
+
+void Base64Stream::reset() {
+    carry_length_ = 0;
+}
+
+void Base64Stream::update(const char* data, size_t length, std::string& out) {
+    const unsigned char* in = (const unsigned char*)data;
+    size_t pos = 0;
+
+    //  ,   
+    if (carry_length_ > 0) {
+        unsigned char triple[3] = { carry_[0], carry_[1], 0 };
+        size_t filled = carry_length_;
+        while (filled < 3 && pos < length)
+            triple[filled++] = in[pos++];
+
+        if (filled < 3) {
+            carry_[0] = triple[0];
+            carry_[1] = triple[1];
+            carry_length_ = filled;
+            return;
+        }
+        encode_triple(triple, out);
+        carry_length_ = 0;
+    }
+
+    out.reserve(out.size() + (length - pos) / 3 * 4 + 4);
+    for (; pos + 3 <= length; pos += 3)
+        encode_triple(in + pos, out);
+
+    for (; pos < length; pos++)
+        carry_[carry_length_++] = in[pos];
+}
+
+void Base64Stream::finish(std::string& out) {
+    if (carry_length_ == 0)
+        return;
+
+    unsigned char triple[3] = { carry_[0], carry_length_ > 1 ? carry_[1] : (unsigned char)0, 0 };
+    encode_triple(triple, out);
+    out[out.size() - 1] = '=';
+    if (carry_length_ == 1)
+        out[out.size() - 2] = '=';
+    carry_length_ = 0;
+}
+
+LargeValueReader::LargeValueReader(PGconn* conn, const std::string& table, const std::string& column,
+    const std::vector<std::string>& key, size_t chunk_size)
+    : conn_(conn), statement_("large_value_" + column), text_(false), chunk_length_(0),
+      offset_(1), done_(true), chunk_(nullptr) {
+    std::string sql = "SELECT substring(" + column + " FROM $1::integer FOR $2::integer) FROM " + table + " WHERE ";
+    for (size_t i = 0; i < key.size(); i++) {
+        if (i > 0) sql += " AND ";
+        sql += key[i] + " = $" + std::to_string(i + 3);
+    }
+
+    PGresult* res = PQprepare(conn_, statement_.c_str(), sql.c_str(), 0, nullptr);
+    if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+        std::string error_msg = PQerrorMessage(conn_);
+        PQclear(res);
+        throw std::runtime_error("Failed to prepare large value read: " + error_msg);
+    }
+    PQclear(res);
+
+    res = PQdescribePrepared(conn_, statement_.c_str());
+    Oid type = PQresultStatus(res) == PGRES_COMMAND_OK ? PQftype(res, 0) : 0;
+    PQclear(res);
+
+    if (type != BYTEA_OID && type != TEXT_OID && type != BPCHAR_OID && type != VARCHAR_OID) {
+        PQclear(PQexec(conn_, ("DEALLOCATE " + statement_).c_str()));
+        throw std::runtime_error("Column " + column + " of " + table + " must be bytea or text to be streamed");
+    }
+
+    //  text   :  UTF8    4 
+    text_ = type != BYTEA_OID;
+    chunk_length_ = (int)std::max<size_t>(1, text_ ? chunk_size / 4 : chunk_size);
+}
+
+LargeValueReader::~LargeValueReader() {
+    if (chunk_) PQclear(chunk_);
+    PQclear(PQexec(conn_, ("DEALLOCATE " + statement_).c_str()));
+}
+
+bool LargeValueReader::is_text() const {
+    return text_;
+}
+
+void LargeValueReader::open(const std::vector<std::string>& key_values) {
+    key_values_ = key_values;
+    offset_ = 1;
+    done_ = false;
+}
+
+size_t LargeValueReader::next(const char*& data) {
+    if (chunk_) {
+        PQclear(chunk_);
+        chunk_ = nullptr;
+    }
+    if (done_)
+        return 0;
+
+    std::string offset = std::to_string(offset_);
+    std::string length = std::to_string(chunk_length_);
+    std::vector<const char*> params = { offset.c_str(), length.c_str() };
+    for (const auto& value : key_values_)
+        params.push_back(value.c_str());
+
+    chunk_ = PQexecPrepared(conn_, statement_.c_str(), (int)params.size(), params.data(), nullptr, nullptr, 1);
+    if (PQresultStatus(chunk_) != PGRES_TUPLES_OK)
+        throw std::runtime_error("Failed to read large value: " + std::string(PQerrorMessage(conn_)));
+
+    if (PQntuples(chunk_) == 0 || PQgetisnull(chunk_, 0, 0)) {
+        done_ = true;
+        return 0;
+    }
+
+    data = PQgetvalue(chunk_, 0, 0);
+    int bytes = PQgetlength(chunk_, 0, 0);
+
+    long long units = bytes;
+    if (text_) {
+        units = 0;
+        for (int i = 0; i < bytes; i++) {
+            if ((data[i] & 0xC0) != 0x80)
+                units++;
+        }
+    }
+
+    offset_ += units;
+    if (units < chunk_length_)
+        done_ = true;
+
+    return (size_t)bytes;
+}
+
+LargeObjectWriter::LargeObjectWriter(PGconn* conn)
+    : conn_(conn), oid_(InvalidOid), fd_(-1) {
+}
+
+LargeObjectWriter::~LargeObjectWriter() {
+}
+
+void LargeObjectWriter::begin() {
+    PGresult* res = PQexec(conn_, "BEGIN");
+    bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+    PQclear(res);
+    if (!ok)
+        throw std::runtime_error("Failed to begin large value transfer: " + std::string(PQerrorMessage(conn_)));
+
+    oid_ = lo_creat(conn_, INV_READ | INV_WRITE);
+    if (oid_ == InvalidOid)
+        throw std::runtime_error("Failed to create large object: " + std::string(PQerrorMessage(conn_)));
+
+    fd_ = lo_open(conn_, oid_, INV_WRITE);
+    if (fd_ < 0)
+        throw std::runtime_error("Failed to open large object: " + std::string(PQerrorMessage(conn_)));
+}
+
+void LargeObjectWriter::write(const char* data, size_t length) {
+    while (length > 0) {
+        int written = lo_write(conn_, fd_, data, length);
+        if (written <= 0)
+            throw std::runtime_error("Failed to write large object: " + std::string(PQerrorMessage(conn_)));
+        data += written;
+        length -= (size_t)written;
+    }
+}
+
+//    ; $1  - OID  ,  -  
+long long LargeObjectWriter::commit(const std::string& update_sql, const std::vector<std::string>& key_values) {
+    if (lo_close(conn_, fd_) < 0)
+        throw std::runtime_error("Failed to close large object: " + std::string(PQerrorMessage(conn_)));
+    fd_ = -1;
+
+    std::string oid = std::to_string(oid_);
+    std::vector<const char*> params = { oid.c_str() };
+    for (const auto& value : key_values)
+        params.push_back(value.c_str());
+
+    PGresult* res = PQexecParams(conn_, update_sql.c_str(), (int)params.size(), nullptr, params.data(), nullptr, nullptr, 0);
+    if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+        std::string error_msg = PQerrorMessage(conn_);
+        PQclear(res);
+        throw std::runtime_error("Failed to store large value: " + error_msg);
+    }
+    long long updated = std::atoll(PQcmdTuples(res));
+    PQclear(res);
+    if (updated > 1)
+        throw std::runtime_error("Large value key matches " + std::to_string(updated) + " rows");
+
+    if (lo_unlink(conn_, oid_) < 0)
+        throw std::runtime_error("Failed to remove large object: " + std::string(PQerrorMessage(conn_)));
+    oid_ = InvalidOid;
+
+    res = PQexec(conn_, "COMMIT");
+    bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+    PQclear(res);
+    if (!ok)
+        throw std::runtime_error("Failed to commit large value: " + std::string(PQerrorMessage(conn_)));
+
+    return updated;
+}
+
+// ,    ,  
+void LargeObjectWriter::abort() {
+    PQclear(PQexec(conn_, "ROLLBACK"));
+    oid_ = InvalidOid;
+    fd_ = -1;
+}
@@ -0,0 +1,73 @@
+/*
+* ================== LARGE_VALUE ==================
+*          :
+*   - LargeValueReader -   bytea/text  
+*       substring (TOAST   )
+*   - LargeObjectWriter -       
+*        (lo_write),    UPDATE
+*           
+*   - Base64Stream -  base64  
+*       .
+*/
+
+#pragma once
+
+#ifndef LARGE_VALUE_H
+#define LARGE_VALUE_H
+
+#include <string>
+#include <vector>
+#include <libpq-fe.h>
+
+class Base64Stream {
+public:
+    Base64Stream();
+
+    void reset();
+    void update(const char* data, size_t length, std::string& out);    //    out
+    void finish(std::string& out);
+
+private:
+    unsigned char carry_[2];    // ,    
+    size_t carry_length_;
+};
+
+//      UTF8 ( text   )
+class LargeValueReader {
+public:
+    LargeValueReader(PGconn* conn, const std::string& table, const std::string& column,
+        const std::vector<std::string>& key, size_t chunk_size);
+    ~LargeValueReader();
+
+    bool is_text() const;
+    void open(const std::vector<std::string>& key_values);
+    size_t next(const char*& data);     // 0 -   
+
+private:
+    PGconn* conn_;
+    std::string statement_;
+    bool text_;
+    int chunk_length_;                  //     (bytea)   (text)
+    std::vector<std::string> key_values_;
+    long long offset_;
+    bool done_;
+    PGresult* chunk_;
+};
+
+class LargeObjectWriter {
+public:
+    explicit LargeObjectWriter(PGconn* conn);
+    ~LargeObjectWriter();
+
+    void begin();
+    void write(const char* data, size_t length);
+    long long commit(const std::string& update_sql, const std::vector<std::string>& key_values);
+    void abort();
+
+private:
+    PGconn* conn_;
+    Oid oid_;
+    int fd_;
+};
+
+#endif // LARGE_VALUE_H
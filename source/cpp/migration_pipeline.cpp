@@ -0,0 +1,271 @@
+#include "migration_pipeline.h"
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+
+//    -     
+static const size_t MIN_BATCHES = 3;
+
+RowBatch::RowBatch()
+    : cols_(0) {
+}
+
+void RowBatch::reset(int cols) {
+    cols_ = cols;
+    data_.clear();
+    offsets_.clear();
+    lengths_.clear();
+    routes_.clear();
+}
+
+void RowBatch::add_value(const char* value, int length) {
+    offsets_.push_back(data_.size());
+    lengths_.push_back(length);
+    data_.append(value, length);
+    data_.push_back('\0');      //     C-
+}
+
+void RowBatch::add_null() {
+    offsets_.push_back(data_.size());
+    lengths_.push_back(-1);
+}
+
+//        
+void RowBatch::set_route(int row, int shard) {
+    if ((size_t)row >= routes_.size())
+        routes_.resize(rows(), -1);
+    routes_[row] = shard;
+}
+
+void RowBatch::swap(RowBatch& other) {
+    std::swap(cols_, other.cols_);
+    data_.swap(other.data_);
+    offsets_.swap(other.offsets_);
+    lengths_.swap(other.lengths_);
+    routes_.swap(other.routes_);
+}
+
+int RowBatch::rows() const {
+    return cols_ > 0 ? (int)(lengths_.size() / cols_) : 0;
+}
+
+int RowBatch::cols() const {
+    return cols_;
+}
+
+bool RowBatch::is_null(int row, int col) const {
+    return lengths_[(size_t)row * cols_ + col] < 0;
+}
+
+const char* RowBatch::value(int row, int col) const {
+    return data_.data() + offsets_[(size_t)row * cols_ + col];
+}
+
+int RowBatch::length(int row, int col) const {
+    int length = lengths_[(size_t)row * cols_ + col];
+    return length < 0 ? 0 : length;
+}
+
+int RowBatch::route(int row) const {
+    return (size_t)row < routes_.size() ? routes_[row] : -1;
+}
+
+size_t RowBatch::bytes() const {
+    return data_.size();
+}
+
+size_t RowBatch::capacity() const {
+    return data_.capacity() + offsets_.capacity() * sizeof(size_t) + (lengths_.capacity() + routes_.capacity()) * sizeof(int);
+}
+
+MigrationPipeline::MigrationPipeline(size_t memory_limit, size_t queue_capacity)
+    : memory_limit_(memory_limit), queue_capacity_(queue_capacity), stopped_(false), wall_seconds_(0) {
+}
+
+void MigrationPipeline::fail(std::exception_ptr error) {
+    //   ;   ,  stopped_
+    if (!stopped_.exchange(true))
+        error_ = error;
+}
+
+//     ; false -  
+template <typename Ready>
+bool MigrationPipeline::wait_for(Ready ready) {
+    for (int spins = 0; !ready(); spins++) {
+        if (stopped_)
+            return false;
+        if (spins < 64)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    return true;
+}
+
+void MigrationPipeline::run(const FetchStage& fetch, const TransformStage& transform, const std::vector<Writer>& writers) {
+    typedef std::chrono::steady_clock Clock;
+
+    size_t writer_count = writers.size();
+    size_t max_slots = queue_capacity_ * 2 + MIN_BATCHES + writer_count;
+    std::atomic<size_t> failed_writers(0);
+
+    stats_.clear();
+    stats_.push_back({ "fetch", 0, 0, "" });
+    stats_.push_back({ "transform", 0, 0, "" });
+    for (const auto& writer : writers)
+        stats_.push_back({ writer.name.empty() ? "write" : "write " + writer.name, 0, 0, "" });
+
+    //    nullptr;        
+    SpscQueue<Slot*> fetched(queue_capacity_);
+    std::vector<std::unique_ptr<SpscQueue<Slot*>>> targets;
+    std::vector<std::unique_ptr<SpscQueue<Slot*>>> released;
+    for (size_t i = 0; i < writer_count; i++) {
+        targets.emplace_back(new SpscQueue<Slot*>(queue_capacity_));
+        released.emplace_back(new SpscQueue<Slot*>(max_slots));
+    }
+    std::vector<std::unique_ptr<Slot>> slots;
+
+    auto measure = [](StageStats& stats, const std::function<void()>& work) {
+        auto start = Clock::now();
+        work();
+        stats.busy_seconds += std::chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    auto start = Clock::now();
+
+    std::thread reader([&] {
+        try {
+            size_t reserved = 0;
+            size_t next_release = 0;
+            Slot* slot = nullptr;
+            auto reuse = [&] {
+                for (size_t i = 0; i < writer_count; i++, next_release++) {
+                    if (released[next_release % writer_count]->try_pop(slot))
+                        return true;
+                }
+                return false;
+            };
+
+            while (!stopped_) {
+                //   ,     ,   
+                if (!reuse()) {
+                    if (slots.size() < MIN_BATCHES || (reserved < memory_limit_ && slots.size() < max_slots)) {
+                        slots.emplace_back(new Slot());
+                        slot = slots.back().get();
+                    }
+                    else if (!wait_for(reuse)) {
+                        break;
+                    }
+                }
+
+                size_t before = slot->batch.capacity();
+                measure(stats_[0], [&] { fetch(slot->batch); });
+                reserved += slot->batch.capacity() - before;
+                stats_[0].rows += slot->batch.rows();
+
+                Slot* item = slot->batch.rows() > 0 ? slot : nullptr;
+                if (!wait_for([&] { return fetched.try_push(item); }) || !item)
+                    break;
+            }
+        }
+        catch (...) {
+            fail(std::current_exception());
+        }
+    });
+
+    std::thread transformer([&] {
+        try {
+            while (!stopped_) {
+                Slot* slot = nullptr;
+                if (!wait_for([&] { return fetched.try_pop(slot); }))
+                    break;
+                if (slot) {
+                    measure(stats_[1], [&] { transform(slot->batch); });
+                    slot->readers = (int)writer_count;
+                }
+
+                //      
+                for (size_t i = 0; i < writer_count; i++) {
+                    if (!wait_for([&] { return targets[i]->try_push(slot); }))
+                        return;
+                }
+                if (!slot)
+                    break;
+            }
+        }
+        catch (...) {
+            fail(std::current_exception());
+        }
+    });
+
+    std::vector<std::thread> writer_threads;
+    for (size_t i = 0; i < writer_count; i++) {
+        writer_threads.emplace_back([&, i] {
+            StageStats& stats = stats_[2 + i];
+            while (true) {
+                Slot* slot = nullptr;
+                if (!wait_for([&] { return targets[i]->try_pop(slot); }) || !slot)
+                    break;
+
+                //      ,   
+                if (stats.error.empty()) {
+                    try {
+                        measure(stats, [&] { writers[i].write(slot->batch); });
+                        stats.rows += slot->batch.rows();
+                    }
+                    catch (const std::exception& e) {
+                        stats.error = e.what();
+                    }
+                    catch (...) {
+                        stats.error = "unknown error";
+                    }
+
+                    if (!stats.error.empty() && ++failed_writers == writer_count)
+                        stopped_ = true;
+                }
+
+                //       
+                if (--slot->readers == 0 && !wait_for([&] { return released[i]->try_push(slot); }))
+                    break;
+            }
+        });
+    }
+
+    reader.join();
+    transformer.join();
+    for (auto& thread : writer_threads)
+        thread.join();
+
+    wall_seconds_ = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (error_)
+        std::rethrow_exception(error_);
+}
+
+long long MigrationPipeline::read_rows() const {
+    return stats_[0].rows;
+}
+
+long long MigrationPipeline::rows(size_t writer) const {
+    return stats_[2 + writer].rows;
+}
+
+const std::string& MigrationPipeline::error(size_t writer) const {
+    return stats_[2 + writer].error;
+}
+
+std::string MigrationPipeline::utilization() const {
+    std::stringstream report;
+    const StageStats* bottleneck = &stats_[0];
+
+    for (const auto& stats : stats_) {
+        double share = wall_seconds_ > 0 ? stats.busy_seconds * 100 / wall_seconds_ : 0;
+        report << stats.name << " " << std::fixed << std::setprecision(0) << share << "% busy, ";
+        if (stats.busy_seconds > bottleneck->busy_seconds)
+            bottleneck = &stats;
+    }
+
+    report << "bottleneck: " << bottleneck->name;
+    return report.str();
+}
@@ -0,0 +1,130 @@
+/*
+* ============== MIGRATION_PIPELINE ==============
+*   :    , 
+*          ,
+*   lock-free   .
+*  ;     
+* memory_limit -       .
+*         :
+*      (  -   )
+*   ,    .
+*/
+
+#pragma once
+
+#ifndef MIGRATION_PIPELINE_H
+#define MIGRATION_PIPELINE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+//  :      
+class RowBatch {
+public:
+    RowBatch();
+
+    void reset(int cols);
+    void add_value(const char* value, int length);
+    void add_null();
+    void set_route(int row, int shard);
+    void swap(RowBatch& other);
+
+    int rows() const;
+    int cols() const;
+    bool is_null(int row, int col) const;
+    const char* value(int row, int col) const;
+    int length(int row, int col) const;
+    int route(int row) const;       // -1 -     
+    size_t bytes() const;
+    size_t capacity() const;
+
+private:
+    int cols_;
+    std::string data_;
+    std::vector<size_t> offsets_;
+    std::vector<int> lengths_;      // -1 - NULL
+    std::vector<int> routes_;       //    
+};
+
+//         
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) : slots_(capacity + 1), head_(0), tail_(0) {}
+
+    bool try_push(const T& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) % slots_.size();
+        if (next == head_.load(std::memory_order_acquire))
+            return false;
+        slots_[tail] = item;
+        tail_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        item = slots_[head];
+        head_.store((head + 1) % slots_.size(), std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> slots_;
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+};
+
+class MigrationPipeline {
+public:
+    typedef std::function<void(RowBatch&)> FetchStage;         //   -  
+    typedef std::function<void(RowBatch&)> TransformStage;
+    typedef std::function<void(const RowBatch&)> WriteStage;
+
+    struct Writer {
+        std::string name;
+        WriteStage write;
+    };
+
+    MigrationPipeline(size_t memory_limit, size_t queue_capacity = 16);
+
+    void run(const FetchStage& fetch, const TransformStage& transform, const std::vector<Writer>& writers);
+
+    long long read_rows() const;                       // ,   
+    long long rows(size_t writer) const;
+    const std::string& error(size_t writer) const;     //   -   
+    std::string utilization() const;
+
+private:
+    //       
+    struct StageStats {
+        std::string name;
+        double busy_seconds;
+        long long rows;
+        std::string error;
+    };
+
+    //    ,    
+    struct Slot {
+        RowBatch batch;
+        std::atomic<int> readers;
+    };
+
+    size_t memory_limit_;
+    size_t queue_capacity_;
+    std::atomic<bool> stopped_;
+    std::exception_ptr error_;
+    double wall_seconds_;
+    std::vector<StageStats> stats_;     // , ,     
+
+    void fail(std::exception_ptr error);
+    template <typename Ready> bool wait_for(Ready ready);
+};
+
+#endif // MIGRATION_PIPELINE_H
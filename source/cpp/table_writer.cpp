@@ -0,0 +1,568 @@
+#include "table_writer.h"
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+//   PostgreSQL    
+static const int MAX_QUERY_PARAMS = 65535;
+
+//   COPY,    libpq (   )
+static const size_t COPY_BUFFER_SIZE = 256 * 1024;
+
+std::string build_conflict_clause(const std::vector<std::string>& columns, const UpsertConfig& upsert) {
+    std::stringstream sql;
+    sql << "ON CONFLICT";
+    if (!upsert.conflict_key.empty()) {
+        sql << " (";
+        for (size_t i = 0; i < upsert.conflict_key.size(); i++) {
+            if (i > 0) sql << ", ";
+            sql << upsert.conflict_key[i];
+        }
+        sql << ")";
+    }
+
+    std::vector<std::string> updated;
+    for (const auto& column : columns) {
+        if (std::find(upsert.conflict_key.begin(), upsert.conflict_key.end(), column) == upsert.conflict_key.end())
+            updated.push_back(column);
+    }
+
+    if (!upsert.update || updated.empty()) {
+        sql << " DO NOTHING";
+    }
+    else {
+        sql << " DO UPDATE SET ";
+        for (size_t i = 0; i < updated.size(); i++) {
+            if (i > 0) sql << ", ";
+            sql << updated[i] << " = EXCLUDED." << updated[i];
+        }
+    }
+
+    return sql.str();
+}
+
+std::string build_upsert_query(const std::string& table, const std::vector<std::string>& columns,
+    const std::vector<std::string>& types, const std::vector<int>& key_columns, int rows, const UpsertConfig& upsert) {
+    std::stringstream sql;
+    sql << "INSERT INTO " << table << " (";
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (i > 0) sql << ", ";
+        sql << columns[i];
+    }
+    sql << ") ";
+
+    //  ,       (1.0  1.00, citext, char(n))
+    //   :      . 
+    //  NULL        
+    std::string keys;
+    if (!key_columns.empty()) {
+        std::string null_key = "CASE WHEN ";
+        for (size_t i = 0; i < key_columns.size(); i++) {
+            if (i > 0) null_key += " OR ";
+            null_key += "v." + columns[key_columns[i]] + " IS NULL";
+        }
+        null_key += " THEN v.migrator_row END";
+
+        for (int key_column : key_columns)
+            keys += "v." + columns[key_column] + ", ";
+        keys += null_key;
+
+        sql << "SELECT DISTINCT ON (" << keys << ") ";
+        for (size_t i = 0; i < columns.size(); i++) {
+            if (i > 0) sql << ", ";
+            sql << "v." << columns[i];
+        }
+        sql << " FROM (";
+    }
+    sql << "VALUES ";
+
+    int param = 1;
+    for (int row = 0; row < rows; row++) {
+        if (row > 0) sql << ",";
+        sql << "(";
+        for (size_t i = 0; i < columns.size(); i++) {
+            if (i > 0) sql << ",";
+            sql << "$" << param++;
+            if (!key_columns.empty())
+                sql << "::" << types[i];
+        }
+        if (!key_columns.empty())
+            sql << "," << row;
+        sql << ")";
+    }
+
+    if (!key_columns.empty()) {
+        sql << ") AS v (";
+        for (size_t i = 0; i < columns.size(); i++)
+            sql << columns[i] << ", ";
+        sql << "migrator_row) ORDER BY " << keys << ", v.migrator_row DESC";
+    }
+
+    sql << " " << build_conflict_clause(columns, upsert);
+
+    return sql.str();
+}
+
+ConflictKeyIndex::ConflictKeyIndex(const std::vector<int>& columns)
+    : columns_(columns) {
+}
+
+bool ConflictKeyIndex::enabled() const {
+    return !columns_.empty();
+}
+
+int ConflictKeyIndex::slot(const RowBatch& batch, int row, int next) {
+    if (columns_.empty())
+        return next;
+
+    key_.clear();
+    for (int col : columns_) {
+        if (batch.is_null(row, col))
+            return next;
+        int length = batch.length(row, col);
+        key_.append((const char*)&length, sizeof(length));
+        key_.append(batch.value(row, col), length);
+    }
+    return slots_.emplace(key_, next).first->second;
+}
+
+void ConflictKeyIndex::clear() {
+    slots_.clear();
+}
+
+TableWriter::TableWriter(PGconn* conn, const std::string& table, const std::vector<std::string>& columns,
+    const std::vector<int>& indexes, const BulkLoadConfig& bulk_load)
+    : conn_(conn), table_(table), columns_(columns), indexes_(indexes), bulk_load_(bulk_load),
+      commit_rows_(0), commit_bytes_(0), shard_(-1), rows_(0) {
+}
+
+TableWriter::~TableWriter() {
+}
+
+void TableWriter::set_shard(int shard) {
+    shard_ = shard;
+}
+
+long long TableWriter::rows() const {
+    return rows_;
+}
+
+//      ,   
+void TableWriter::tune_commit(const std::string& name, const TuningRange& range, int window) {
+    commit_tuner_.reset(new AdaptiveTuner(name, bulk_load_.commit_rows > 0 ? bulk_load_.commit_rows : range.min,
+        range, window));
+    bulk_load_.commit_rows = commit_tuner_->value();
+    commit_started_ = std::chrono::steady_clock::now();
+}
+
+std::string TableWriter::tuning_report() const {
+    return commit_tuner_ ? commit_tuner_->report() : "";
+}
+
+//        
+void TableWriter::committed() {
+    if (!commit_tuner_)
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - commit_started_).count();
+    commit_started_ = now;
+    bulk_load_.commit_rows = commit_tuner_->update(commit_rows_, seconds);
+}
+
+void TableWriter::execute(const std::string& command) {
+    PGresult* res = PQexec(conn_, command.c_str());
+    if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+        std::string error_msg = PQerrorMessage(conn_);
+        PQclear(res);
+        throw std::runtime_error("Failed to execute '" + command + "': " + error_msg);
+    }
+    PQclear(res);
+}
+
+InsertWriter::InsertWriter(PGconn* conn, const std::string& table, const std::vector<std::string>& columns,
+    const std::vector<int>& indexes, const BulkLoadConfig& bulk_load)
+    : TableWriter(conn, table, columns, indexes, bulk_load) {
+    insert_prefix_ = "INSERT INTO " + table_ + " (";
+    for (size_t col = 0; col < columns_.size(); col++) {
+        if (col > 0) insert_prefix_ += ", ";
+        insert_prefix_ += columns_[col];
+    }
+    insert_prefix_ += ") VALUES (";
+
+    //          
+    if (bulk_load_.enabled)
+        execute("BEGIN");
+}
+
+void InsertWriter::write(const RowBatch& batch) {
+    for (int row = 0; row < batch.rows(); row++) {
+        if (!routed(batch, row)) continue;
+
+        std::stringstream insert_stmt;
+        insert_stmt << insert_prefix_;
+
+        for (size_t i = 0; i < indexes_.size(); i++) {
+            int col = indexes_[i];
+            if (i > 0) insert_stmt << ",";
+
+            if (batch.is_null(row, col)) {
+                insert_stmt << "NULL";
+                continue;
+            }
+
+            char* literal = PQescapeLiteral(conn_, batch.value(row, col), batch.length(row, col));
+            if (!literal)
+                throw std::runtime_error("Failed to escape value: " + std::string(PQerrorMessage(conn_)));
+            insert_stmt << literal;
+            PQfreemem(literal);
+        }
+
+        insert_stmt << ")";
+
+        std::string insert_sql = insert_stmt.str();
+        PGresult* insert_res = PQexec(conn_, insert_sql.c_str());
+        if (PQresultStatus(insert_res) != PGRES_COMMAND_OK) {
+            std::string error_msg = PQerrorMessage(conn_);
+            PQclear(insert_res);
+            throw std::runtime_error("Failed to insert data: " + error_msg);
+        }
+        PQclear(insert_res);
+        rows_++;
+
+        if (!bulk_load_.enabled) continue;
+
+        commit_rows_++;
+        commit_bytes_ += (long long)insert_sql.size();
+        if (bulk_load_.commit_due(commit_rows_, commit_bytes_)) {
+            execute("COMMIT");
+            execute("BEGIN");
+            committed();
+            commit_rows_ = 0;
+            commit_bytes_ = 0;
+        }
+    }
+}
+
+void InsertWriter::finish() {
+    if (bulk_load_.enabled)
+        execute("COMMIT");
+}
+
+UpsertWriter::UpsertWriter(PGconn* conn, const std::string& table, const std::vector<std::string>& columns,
+    const std::vector<int>& indexes, const std::vector<Oid>& types, const BulkLoadConfig& bulk_load,
+    const UpsertConfig& upsert, bool binary)
+    : TableWriter(conn, table, columns, indexes, bulk_load), upsert_(upsert), types_(types), binary_(binary) {
+    int cols = std::max(1, (int)columns_.size());
+    batch_rows_ = std::max(1, std::min(upsert_.batch_rows, MAX_QUERY_PARAMS / cols));
+
+    int batch_params = batch_rows_ * cols;
+    values_.resize(batch_params);
+    lengths_.resize(batch_params);
+    formats_.assign(batch_params, binary_ ? 1 : 0);
+
+    //       ,      
+    param_types_.assign(batch_params, 0);
+    if (binary_) {
+        for (int i = 0; i < batch_params; i++)
+            param_types_[i] = types_[indexes_[i % cols]];
+    }
+
+    if (upsert_.update) {
+        for (const auto& key : upsert_.conflict_key) {
+            auto column = std::find(columns_.begin(), columns_.end(), key);
+            if (column == columns_.end()) {
+                key_columns_.clear();
+                break;
+            }
+            key_columns_.push_back((int)(column - columns_.begin()));
+        }
+    }
+
+    std::vector<int> batch_key_columns;
+    for (int key_column : key_columns_)
+        batch_key_columns.push_back(indexes_[key_column]);
+    batch_keys_.reset(new ConflictKeyIndex(batch_key_columns));
+    if (!key_columns_.empty())
+        load_types();
+
+    if (bulk_load_.enabled)
+        execute("BEGIN");
+
+    if (!PQenterPipelineMode(conn_))
+        throw std::runtime_error("Failed to enter pipeline mode: " + std::string(PQerrorMessage(conn_)));
+}
+
+void UpsertWriter::write(const RowBatch& batch) {
+    int cols = (int)indexes_.size();
+    int count = 0;
+    long long bytes = 0;
+    batch_keys_->clear();
+
+    for (int row = 0; row < batch.rows(); row++) {
+        if (!routed(batch, row)) continue;
+
+        //     INSERT ... DO UPDATE -   ("cannot affect
+        // row a second time"),        
+        int slot = batch_keys_->slot(batch, row, count);
+        if (slot < count)
+            rows_++;
+
+        for (int i = 0; i < cols; i++) {
+            int col = indexes_[i];
+            int param = slot * cols + i;
+            if (slot < count)
+                bytes -= lengths_[param];
+            values_[param] = batch.is_null(row, col) ? nullptr : batch.value(row, col);
+            lengths_[param] = batch.length(row, col);
+            bytes += lengths_[param];
+        }
+
+        if (slot < count) continue;
+        if (++count == batch_rows_) {
+            send(count, bytes);
+            count = 0;
+            bytes = 0;
+            batch_keys_->clear();
+        }
+    }
+
+    if (count > 0)
+        send(count, bytes);
+}
+
+//     :      ,    
+void UpsertWriter::load_types() {
+    const char* params[1] = { table_.c_str() };
+    PGresult* res = PQexecParams(conn_,
+        "SELECT attname, quote_ident(attname), format_type(atttypid, NULL) FROM pg_attribute "
+        "WHERE attrelid = $1::regclass AND attnum > 0 AND NOT attisdropped", 1, nullptr, params, nullptr, nullptr, 0);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        std::string error_msg = PQerrorMessage(conn_);
+        PQclear(res);
+        throw std::runtime_error("Failed to read column types of " + table_ + ": " + error_msg);
+    }
+
+    target_types_.assign(columns_.size(), "");
+    for (size_t col = 0; col < columns_.size(); col++) {
+        for (int row = 0; row < PQntuples(res); row++) {
+            if (columns_[col] == PQgetvalue(res, row, 0) || columns_[col] == PQgetvalue(res, row, 1)) {
+                target_types_[col] = PQgetvalue(res, row, 2);
+                break;
+            }
+        }
+    }
+    PQclear(res);
+
+    for (size_t col = 0; col < columns_.size(); col++) {
+        if (target_types_[col].empty())
+            throw std::runtime_error("Column " + columns_[col] + " isn't in target table " + table_);
+    }
+}
+
+//    INSERT   
+void UpsertWriter::send(int count, long long bytes) {
+    if (!error_.empty())
+        throw std::runtime_error("Failed to upsert data: " + error_);
+
+    int params = count * (int)indexes_.size();
+
+    //         
+    int commands = 1;
+    int sent = 1;
+    auto statement = prepared_.find(count);
+    if (statement == prepared_.end()) {
+        statement = prepared_.emplace(count, "upsert_" + std::to_string(count)).first;
+        sent = PQsendPrepare(conn_, statement->second.c_str(),
+            build_upsert_query(table_, columns_, target_types_, key_columns_, count, upsert_).c_str(),
+            params, param_types_.data());
+        commands++;
+    }
+
+    sent = sent && PQsendQueryPrepared(conn_, statement->second.c_str(), params,
+        values_.data(), lengths_.data(), formats_.data(), 0);
+
+    rows_ += count;
+    commit_rows_ += count;
+    commit_bytes_ += bytes;
+    if (sent && bulk_load_.enabled && bulk_load_.commit_due(commit_rows_, commit_bytes_)) {
+        sent = PQsendQueryParams(conn_, "COMMIT", 0, nullptr, nullptr, nullptr, nullptr, 0) &&
+            PQsendQueryParams(conn_, "BEGIN", 0, nullptr, nullptr, nullptr, nullptr, 0);
+        commands += 2;
+        committed();
+        commit_rows_ = 0;
+        commit_bytes_ = 0;
+    }
+
+    if (!sent || !PQpipelineSync(conn_))
+        throw std::runtime_error("Failed to send upsert batch: " + std::string(PQerrorMessage(conn_)));
+    pending_.push_back(commands);
+
+    while ((int)pending_.size() >= upsert_.pipeline_depth)
+        consume_group();
+}
+
+void UpsertWriter::finish() {
+    while (!pending_.empty())
+        consume_group();
+
+    PQexitPipelineMode(conn_);
+
+    if (!error_.empty())
+        throw std::runtime_error("Failed to upsert data: " + error_);
+
+    if (bulk_load_.enabled)
+        execute("COMMIT");
+}
+
+//    ,    
+void UpsertWriter::consume_group() {
+    int commands = pending_.front();
+    pending_.pop_front();
+
+    for (int i = 0; i < commands; i++) {
+        PGresult* res = PQgetResult(conn_);
+        ExecStatusType status = PQresultStatus(res);
+        if (status != PGRES_COMMAND_OK && error_.empty()) {
+            error_ = status == PGRES_PIPELINE_ABORTED ?
+                "pipeline aborted" : std::string(PQresultErrorMessage(res));
+        }
+        PQclear(res);
+        PQclear(PQgetResult(conn_));    // NULL -   
+    }
+
+    PQclear(PQgetResult(conn_));        // PGRES_PIPELINE_SYNC
+}
+
+CopyWriter::CopyWriter(PGconn* conn, const std::string& table, const std::vector<std::string>& columns,
+    const std::vector<int>& indexes, const BulkLoadConfig& bulk_load)
+    : TableWriter(conn, table, columns, indexes, bulk_load), flush_size_(COPY_BUFFER_SIZE), flush_rows_(0) {
+    copy_sql_ = "COPY " + table_ + " (";
+    for (size_t col = 0; col < columns_.size(); col++) {
+        if (col > 0) copy_sql_ += ", ";
+        copy_sql_ += columns_[col];
+    }
+    copy_sql_ += ") FROM STDIN";
+
+    buffer_.reserve(COPY_BUFFER_SIZE + 4096);
+
+    if (bulk_load_.enabled)
+        execute("BEGIN");
+    begin_copy();
+}
+
+void CopyWriter::write(const RowBatch& batch) {
+    for (int row = 0; row < batch.rows(); row++) {
+        if (!routed(batch, row)) continue;
+
+        size_t row_start = buffer_.size();
+        for (size_t i = 0; i < indexes_.size(); i++) {
+            int col = indexes_[i];
+            if (i > 0) buffer_ += '\t';
+
+            if (batch.is_null(row, col)) {
+                buffer_ += "\\N";
+                continue;
+            }
+
+            //    COPY
+            const char* value = batch.value(row, col);
+            int length = batch.length(row, col);
+            for (int pos = 0; pos < length; pos++) {
+                switch (value[pos]) {
+                case '\\': buffer_ += "\\\\"; break;
+                case '\n': buffer_ += "\\n"; break;
+                case '\r': buffer_ += "\\r"; break;
+                case '\t': buffer_ += "\\t"; break;
+                default: buffer_ += value[pos];
+                }
+            }
+        }
+        buffer_ += '\n';
+        rows_++;
+        flush_rows_++;
+
+        //   -   ,   buffer_  row_start
+        long long row_length = (long long)(buffer_.size() - row_start);
+        if (buffer_.size() >= flush_size_)
+            flush();
+
+        if (!bulk_load_.enabled) continue;
+
+        commit_rows_++;
+        commit_bytes_ += row_length;
+        if (bulk_load_.commit_due(commit_rows_, commit_bytes_)) {
+            end_copy();
+            execute("COMMIT");
+            execute("BEGIN");
+            begin_copy();
+            committed();
+            commit_rows_ = 0;
+            commit_bytes_ = 0;
+        }
+    }
+}
+
+void CopyWriter::finish() {
+    end_copy();
+    if (bulk_load_.enabled)
+        execute("COMMIT");
+}
+
+//      ,   
+void CopyWriter::tune_flush(const std::string& name, const TuningRange& range, int window) {
+    flush_tuner_.reset(new AdaptiveTuner(name, (long long)flush_size_, range, window, 4096));
+    flush_size_ = (size_t)flush_tuner_->value();
+    flush_started_ = std::chrono::steady_clock::now();
+}
+
+std::string CopyWriter::tuning_report() const {
+    std::string report = TableWriter::tuning_report();
+    if (flush_tuner_)
+        report += (report.empty() ? "" : "; ") + flush_tuner_->report();
+    return report;
+}
+
+void CopyWriter::begin_copy() {
+    PGresult* res = PQexec(conn_, copy_sql_.c_str());
+    if (PQresultStatus(res) != PGRES_COPY_IN) {
+        std::string error_msg = PQerrorMessage(conn_);
+        PQclear(res);
+        throw std::runtime_error("Failed to start COPY: " + error_msg);
+    }
+    PQclear(res);
+}
+
+void CopyWriter::end_copy() {
+    flush();
+    if (PQputCopyEnd(conn_, nullptr) != 1)
+        throw std::runtime_error("Failed to finish COPY: " + std::string(PQerrorMessage(conn_)));
+
+    std::string error_msg;
+    PGresult* res;
+    while ((res = PQgetResult(conn_)) != nullptr) {
+        if (PQresultStatus(res) != PGRES_COMMAND_OK && error_msg.empty())
+            error_msg = PQresultErrorMessage(res);
+        PQclear(res);
+    }
+
+    if (!error_msg.empty())
+        throw std::runtime_error("Failed to copy data: " + error_msg);
+}
+
+void CopyWriter::flush() {
+    if (buffer_.empty())
+        return;
+
+    if (PQputCopyData(conn_, buffer_.data(), (int)buffer_.size()) != 1)
+        throw std::runtime_error("Failed to send COPY data: " + std::string(PQerrorMessage(conn_)));
+    buffer_.clear();
+
+    //   -   :  ,   
+    if (flush_tuner_) {
+        auto now = std::chrono::steady_clock::now();
+        flush_size_ = (size_t)flush_tuner_->update(flush_rows_, std::chrono::duration<double>(now - flush_started_).count());
+        flush_started_ = now;
+    }
+    flush_rows_ = 0;
+}
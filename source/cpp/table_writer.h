@@ -0,0 +1,157 @@
+/*
+* ================== TABLE_WRITER ==================
+*      . :
+*   - InsertWriter -  INSERT   
+*     (,   COPY  : ,   )
+*   - UpsertWriter -   INSERT ... ON CONFLICT,
+*         libpq
+*   - CopyWriter -  COPY FROM STDIN   
+*       bulk_load  (
+*     - tune_commit; CopyWriter
+*     ,  libpq   - tune_flush),
+*      (indexes) ,  
+*  ,   ,    .
+*/
+
+#pragma once
+
+#ifndef TABLE_WRITER_H
+#define TABLE_WRITER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <chrono>
+#include <libpq-fe.h>
+#include "adaptive_tuner.h"
+#include "database_migrator.h"
+#include "migration_pipeline.h"
+
+//  ON CONFLICT  INSERT   columns
+std::string build_conflict_clause(const std::vector<std::string>& columns, const UpsertConfig& upsert);
+
+//  INSERT ... ON CONFLICT  rows  .   key_columns
+// (    columns),        
+//       (DISTINCT ON),     types
+std::string build_upsert_query(const std::string& table, const std::vector<std::string>& columns,
+    const std::vector<std::string>& types, const std::vector<int>& key_columns, int rows, const UpsertConfig& upsert);
+
+//     INSERT:       
+// .   , NULL       
+class ConflictKeyIndex {
+public:
+    explicit ConflictKeyIndex(const std::vector<int>& columns);    //    
+
+    bool enabled() const;
+    int slot(const RowBatch& batch, int row, int next);     //  : next       
+    void clear();
+
+private:
+    std::vector<int> columns_;
+    std::unordered_map<std::string, int> slots_;
+    std::string key_;
+};
+
+class TableWriter {
+public:
+    TableWriter(PGconn* conn, const std::string& table, const std::vector<std::string>& columns,
+        const std::vector<int>& indexes, const BulkLoadConfig& bulk_load);
+    virtual ~TableWriter();
+
+    virtual void write(const RowBatch& batch) = 0;
+    virtual void finish() = 0;
+
+    void set_shard(int shard);
+    void tune_commit(const std::string& name, const TuningRange& range, int window);
+    long long rows() const;
+    virtual std::string tuning_report() const;
+
+protected:
+    PGconn* conn_;
+    std::string table_;
+    std::vector<std::string> columns_;
+    std::vector<int> indexes_;          //      columns_
+    BulkLoadConfig bulk_load_;
+    long long commit_rows_;
+    long long commit_bytes_;
+    int shard_;                         // -1 -   
+    long long rows_;
+    std::unique_ptr<AdaptiveTuner> commit_tuner_;
+    std::chrono::steady_clock::time_point commit_started_;
+
+    void execute(const std::string& command);
+    void committed();
+    bool routed(const RowBatch& batch, int row) const {
+        return shard_ < 0 || batch.route(row) == shard_;
+    }
+};
+
+class InsertWriter : public TableWriter {
+public:
+    InsertWriter(PGconn* conn, const std::string& table, const std::vector<std::string>& columns,
+        const std::vector<int>& indexes, const BulkLoadConfig& bulk_load);
+
+    void write(const RowBatch& batch) override;
+    void finish() override;
+
+private:
+    std::string insert_prefix_;
+};
+
+class UpsertWriter : public TableWriter {
+public:
+    UpsertWriter(PGconn* conn, const std::string& table, const std::vector<std::string>& columns,
+        const std::vector<int>& indexes, const std::vector<Oid>& types, const BulkLoadConfig& bulk_load, const UpsertConfig& upsert, bool binary);
+
+    void write(const RowBatch& batch) override;
+    void finish() override;
+
+private:
+    UpsertConfig upsert_;
+    std::vector<Oid> types_;
+    bool binary_;
+    int batch_rows_;
+    std::map<int, std::string> prepared_;   //   ->   
+    std::deque<int> pending_;               //        
+    std::string error_;
+    std::vector<int> key_columns_;          //     columns_ ( DO UPDATE)
+    std::vector<std::string> target_types_; //       
+    std::unique_ptr<ConflictKeyIndex> batch_keys_;
+
+    std::vector<const char*> values_;
+    std::vector<int> lengths_;
+    std::vector<int> formats_;
+    std::vector<Oid> param_types_;
+
+    void load_types();
+    void send(int rows, long long bytes);
+    void consume_group();
+};
+
+class CopyWriter : public TableWriter {
+public:
+    CopyWriter(PGconn* conn, const std::string& table, const std::vector<std::string>& columns,
+        const std::vector<int>& indexes, const BulkLoadConfig& bulk_load);
+
+    void write(const RowBatch& batch) override;
+    void finish() override;
+    void tune_flush(const std::string& name, const TuningRange& range, int window);
+    std::string tuning_report() const override;
+
+private:
+    std::string copy_sql_;
+    std::string buffer_;                // ,    libpq
+    size_t flush_size_;                 //  buffer_,     libpq
+    long long flush_rows_;              //   buffer_
+    std::unique_ptr<AdaptiveTuner> flush_tuner_;
+    std::chrono::steady_clock::time_point flush_started_;
+
+    void begin_copy();
+    void end_copy();
+    void flush();
+};
+
+#endif // TABLE_WRITER_H
@@ -0,0 +1,73 @@
+#include "adaptive_tuner.h"
+#include "test_check.h"
+#include <algorithm>
+#include <cmath>
+
+//      peak:   value 
+static double step_seconds(long long value, double peak) {
+    double x = value / peak;
+    double rate = 10000.0 * 2 * x / (1 + x * x);
+    return value / rate;
+}
+
+static long long tune(AdaptiveTuner& tuner, double peak, int steps) {
+    long long value = tuner.value();
+    for (int i = 0; i < steps && !tuner.converged(); i++)
+        value = tuner.update(value, step_seconds(value, peak));
+    return value;
+}
+
+static void test_converges_to_peak() {
+    for (double peak : { 300.0, 8000.0, 60000.0 }) {
+        AdaptiveTuner tuner("test", 1000, TuningRange(100, 100000), 1);
+        long long value = tune(tuner, peak, 200);
+        CHECK(tuner.converged());
+        CHECK(value >= peak / 2 && value <= peak * 2);
+    }
+}
+
+static void test_range_and_alignment() {
+    //    :    max,        align
+    TuningRange range(64 * 1024, 1024 * 1024);
+    AdaptiveTuner tuner("test", 16, range, 2, 4096);
+    CHECK(tuner.value() == range.min);
+
+    long long value = tuner.value(), largest = value;
+    for (int i = 0; i < 100; i++) {
+        value = tuner.update(value, 1.0);
+        CHECK(value >= range.min && value <= range.max);
+        CHECK(value % 4096 == 0);
+        largest = std::max(largest, value);
+    }
+    CHECK(largest == range.max);
+}
+
+static void test_window() {
+    //     window 
+    AdaptiveTuner tuner("test", 1000, TuningRange(100, 100000), 3);
+    CHECK(tuner.update(1000, 1.0) == 1000);
+    CHECK(tuner.update(1000, 1.0) == 1000);
+    CHECK(tuner.update(1000, 1.0) != 1000);
+}
+
+static void test_max_latency() {
+    //   max_latency  ,    
+    TuningRange range(100, 100000);
+    range = json{ { "min", 100 }, { "max", 100000 }, { "max_latency", 0.5 } };
+    AdaptiveTuner tuner("test", 50000, range, 1);
+    long long value = tuner.value();
+    for (int i = 0; i < 50; i++)
+        value = tuner.update(value, value / 10000.0);
+    CHECK(value / 10000.0 <= 0.5 * 2);
+
+    CHECK_THROWS((range = json{ { "min", 10 }, { "max", 5 } }));
+    CHECK_THROWS((range = json{ { "min", 0 } }));
+}
+
+int main() {
+    test_converges_to_peak();
+    test_range_and_alignment();
+    test_window();
+    test_max_latency();
+    return test_result();
+}
@@ -0,0 +1,54 @@
+#include "backup_io.h"
+#include "test_check.h"
+#include <cstdio>
+#include <string>
+
+static std::string read_all(BackupReader& reader) {
+    std::string data;
+    const char* chunk = nullptr;
+    size_t length;
+    while ((length = reader.next(chunk)) > 0)
+        data.append(chunk, length);
+    return data;
+}
+
+//        ,       
+static void test_round_trip(bool direct, bool io_uring) {
+    BackupIOConfig config;
+    config = json{ { "buffer_size", 65536 }, { "direct", direct }, { "io_uring", io_uring }, { "adaptive", false } };
+
+    std::string data;
+    for (int i = 0; i < 1000003; i++)
+        data += (char)(i * 7 + i / 251);
+
+    std::string path = "backup_reader_test.bin";
+    {
+        BackupWriter writer(path, config);
+        CHECK(writer.is_open());
+        writer.write(data.data(), 12345);
+        writer.write(data.data() + 12345, data.size() - 12345);
+        writer.close();
+    }
+
+    BackupReader whole(path, config);
+    CHECK(whole.is_open());
+    CHECK(read_all(whole) == data);
+
+    //   :   ,  -      
+    long long ranges[][2] = { { 0, 100 }, { 4095, 70000 }, { 65536, 65536 }, { 999000, 1003 }, { 1000003, 0 } };
+    for (const auto& range : ranges) {
+        BackupReader reader(path, config, range[0], range[1]);
+        CHECK(reader.is_open());
+        CHECK(read_all(reader) == data.substr((size_t)range[0], (size_t)range[1]));
+    }
+
+    std::remove(path.c_str());
+}
+
+int main() {
+    for (bool direct : { false, true }) {
+        for (bool io_uring : { false, true })
+            test_round_trip(direct, io_uring);
+    }
+    return test_result();
+}
@@ -0,0 +1,70 @@
+#include "large_value.h"
+#include "external/base64.hpp"
+#include "test_check.h"
+#include <algorithm>
+#include <string>
+
+static std::string encode(const std::string& data, size_t step) {
+    Base64Stream stream;
+    std::string out;
+    for (size_t pos = 0; pos < data.size(); pos += step)
+        stream.update(data.data() + pos, std::min(step, data.size() - pos), out);
+    stream.finish(out);
+    return out;
+}
+
+static void test_vectors() {
+    // RFC 4648,  10
+    const char* vectors[][2] = {
+        { "", "" }, { "f", "Zg==" }, { "fo", "Zm8=" }, { "foo", "Zm9v" },
+        { "foob", "Zm9vYg==" }, { "fooba", "Zm9vYmE=" }, { "foobar", "Zm9vYmFy" }
+    };
+    for (const auto& vector : vectors) {
+        CHECK(encode(vector[0], 1) == vector[1]);
+        CHECK(encode(vector[0], 1000) == vector[1]);
+    }
+}
+
+static void test_split_parts() {
+    //       ,       
+    std::string data;
+    for (int i = 0; i < 1000; i++)
+        data += (char)(i * 37);
+    std::string expected = Base64::encode(data);
+
+    for (size_t step : { (size_t)1, (size_t)2, (size_t)4, (size_t)5, (size_t)64, (size_t)999 })
+        CHECK(encode(data, step) == expected);
+
+    Base64Stream stream;
+    std::string out;
+    stream.update(data.data(), 1, out);
+    stream.update(data.data() + 1, 0, out);
+    stream.update(data.data() + 1, data.size() - 1, out);
+    stream.finish(out);
+    CHECK(out == expected);
+}
+
+static void test_reset() {
+    Base64Stream stream;
+    std::string out;
+    stream.update("ab", 2, out);
+    stream.reset();
+    stream.update("foo", 3, out);
+    stream.finish(out);
+    CHECK(out == "Zm9v");
+
+    // finish     ,     
+    out.clear();
+    stream.finish(out);
+    CHECK(out.empty());
+    stream.update("f", 1, out);
+    stream.finish(out);
+    CHECK(out == "Zg==");
+}
+
+int main() {
+    test_vectors();
+    test_split_parts();
+    test_reset();
+    return test_result();
+}
@@ -0,0 +1,183 @@
+#include "chunk_store.h"
+#include "test_check.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+static const char* REPOSITORY = "chunk_store_test_repository";
+
+static void test_sha256() {
+    // FIPS 180-2,  B
+    CHECK(sha256_hex("", 0) == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    CHECK(sha256_hex("abc", 3) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    std::string two_blocks = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    CHECK(sha256_hex(two_blocks.data(), two_blocks.size()) ==
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    std::string million(1000000, 'a');
+    CHECK(sha256_hex(million.data(), million.size()) ==
+        "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+//  :       
+static std::string random_data(size_t size, unsigned seed) {
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (char)(seed >> 16);
+    }
+    return data;
+}
+
+static ManifestTable split(ChunkStore& store, const ChunkStoreConfig& config, const std::string& data, size_t step) {
+    ChunkSplitter splitter(store, config);
+    splitter.begin("t");
+    for (size_t pos = 0; pos < data.size(); pos += step)
+        splitter.write(data.data() + pos, std::min(step, data.size() - pos));
+    return splitter.end();
+}
+
+static std::string read(const ChunkStore& store, const ManifestTable& table) {
+    ChunkStreamReader reader(store, table.chunks, 3);
+    std::string data;
+    const char* chunk = nullptr;
+    size_t length;
+    while ((length = reader.next(chunk)) > 0)
+        data.append(chunk, length);
+    return data;
+}
+
+static void test_splitter() {
+    ChunkStoreConfig config;
+    config = json{ { "path", REPOSITORY }, { "min_chunk", 1024 }, { "avg_chunk", 4096 }, { "max_chunk", 16384 },
+        { "threads", 2 } };
+    ChunkStore store(REPOSITORY);
+    std::string data = random_data(1 << 20, 1);
+
+    ManifestTable table = split(store, config, data, 1 << 20);
+    CHECK(table.size == (long long)data.size());
+    CHECK(table.chunks.size() > 64);
+    size_t total = 0;
+    for (size_t i = 0; i < table.chunks.size(); i++) {
+        const ChunkRef& chunk = table.chunks[i];
+        CHECK(chunk.size <= config.max_chunk);
+        CHECK(chunk.size > config.min_chunk || i + 1 == table.chunks.size());
+        CHECK(sha256_hex(data.data() + total, chunk.size) == chunk.hash);
+        total += chunk.size;
+    }
+    CHECK(total == data.size());
+    CHECK(read(store, table) == data);
+
+    //     ,    
+    ManifestTable parts = split(store, config, data, 777);
+    CHECK(parts.chunks.size() == table.chunks.size());
+    for (size_t i = 0; i < parts.chunks.size() && i < table.chunks.size(); i++)
+        CHECK(parts.chunks[i].hash == table.chunks[i].hash);
+
+    //       ,    
+    std::string shifted = random_data(100, 2) + data;
+    ManifestTable changed = split(store, config, shifted, 4096);
+    CHECK(read(store, changed) == shifted);
+    size_t common = 0;
+    for (size_t i = 0; i < changed.chunks.size() && i < table.chunks.size(); i++) {
+        if (changed.chunks[changed.chunks.size() - 1 - i].hash == table.chunks[table.chunks.size() - 1 - i].hash)
+            common++;
+    }
+    CHECK(common + 3 >= table.chunks.size());
+}
+
+static void test_store() {
+    ChunkStore store(REPOSITORY);
+    std::string data = "chunk data";
+    std::string hash = sha256_hex(data.data(), data.size());
+    store.put(hash, data.data(), data.size());
+    CHECK(!store.put(hash, data.data(), data.size()));
+
+    std::vector<char> read;
+    store.get({ hash, data.size() }, read);
+    CHECK(std::string(read.begin(), read.end()) == data);
+    CHECK_THROWS(store.get({ hash, data.size() - 1 }, read));
+    CHECK_THROWS(store.get({ sha256_hex("other", 5), 5 }, read));
+
+    //    
+    std::string path = (fs::path(REPOSITORY) / hash.substr(0, 2) / hash).string();
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << "chunk dat!";
+    CHECK_THROWS(store.get({ hash, data.size() }, read));
+}
+
+static void test_manifest() {
+    BackupManifest manifest;
+    manifest.repository = REPOSITORY;
+    manifest.tables.push_back({ "public.users", 0, 30, { { "id", "bigint" }, { "name", "text" } },
+        { { sha256_hex("a", 1), 10 }, { sha256_hex("b", 1), 20 } } });
+    manifest.tables.push_back({ "orders", 0, 0, {}, {} });
+    manifest.save("chunk_store_test.json");
+    CHECK(BackupManifest::is_manifest("chunk_store_test.json"));
+
+    BackupManifest loaded;
+    loaded.load("chunk_store_test.json");
+    CHECK(loaded.format == "chunks");
+    CHECK(loaded.repository == REPOSITORY);
+    CHECK(loaded.tables.size() == 2);
+    const ManifestTable* users = loaded.find("public.users");
+    CHECK(users && users->size == 30 && users->columns.size() == 2 && users->chunks.size() == 2);
+    if (users && users->columns.size() == 2 && users->chunks.size() == 2) {
+        CHECK(users->columns[1].name == "name" && users->columns[1].type == "text");
+        CHECK(users->chunks[1].hash == sha256_hex("b", 1) && users->chunks[1].size == 20);
+    }
+    CHECK(loaded.find("orders") && loaded.find("orders")->chunks.empty());
+    CHECK(!loaded.find("missing"));
+
+    //          
+    BackupManifest file_manifest;
+    file_manifest.format = "file";
+    file_manifest.file = "backup.bin";
+    file_manifest.tables.push_back({ "a", 0, 100, { { "id", "integer" } }, {} });
+    file_manifest.tables.push_back({ "b", 100, 50, {}, {} });
+    file_manifest.save("chunk_store_test.bin.manifest");
+    loaded.load("chunk_store_test.bin.manifest");
+    CHECK(loaded.format == "file" && loaded.file == "backup.bin");
+    CHECK(loaded.find("b") && loaded.find("b")->offset == 100 && loaded.find("b")->size == 50);
+
+    std::ofstream("chunk_store_test.bin", std::ios::binary) << std::string("PGCOPY\n\377\r\n\0", 11);
+    CHECK(!BackupManifest::is_manifest("chunk_store_test.bin"));
+    CHECK_THROWS(loaded.load("chunk_store_test_missing.json"));
+}
+
+static void test_prune() {
+    fs::remove_all(REPOSITORY);
+    ChunkStore store(REPOSITORY);
+    std::vector<std::string> hashes;
+    for (const char* data : { "one", "two", "three" }) {
+        hashes.push_back(sha256_hex(data, strlen(data)));
+        store.put(hashes.back(), data, strlen(data));
+    }
+    std::string other = (fs::path(REPOSITORY) / hashes[0].substr(0, 2) / "notes.txt").string();
+    std::ofstream(other) << "not a chunk";
+
+    long long removed_bytes = 0;
+    CHECK(store.prune({ hashes[0], hashes[2] }, removed_bytes) == 1);
+    CHECK(removed_bytes == 3);
+
+    std::vector<char> data;
+    store.get({ hashes[0], 3 }, data);
+    store.get({ hashes[2], 5 }, data);
+    CHECK_THROWS(store.get({ hashes[1], 3 }, data));
+    CHECK(fs::exists(other));
+}
+
+int main() {
+    fs::remove_all(REPOSITORY);
+    test_sha256();
+    test_splitter();
+    test_store();
+    test_manifest();
+    test_prune();
+    fs::remove_all(REPOSITORY);
+    for (const char* path : { "chunk_store_test.json", "chunk_store_test.bin.manifest", "chunk_store_test.bin" })
+        fs::remove(path);
+    return test_result();
+}
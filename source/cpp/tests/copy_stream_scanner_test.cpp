@@ -0,0 +1,88 @@
+#include "backup_io.h"
+#include "test_check.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static void put_int(std::string& out, long long value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--)
+        out += (char)((value >> (i * 8)) & 0xFF);
+}
+
+//  COPY BINARY: ,  (NULL - nullptr)   
+static std::string copy_stream(const std::vector<std::vector<const char*>>& rows, const std::string& extension = "") {
+    std::string out("PGCOPY\n\377\r\n\0", 11);
+    put_int(out, 0, 4);
+    put_int(out, (long long)extension.size(), 4);
+    out += extension;
+    for (const auto& row : rows) {
+        put_int(out, (long long)row.size(), 2);
+        for (const char* value : row) {
+            if (!value) {
+                put_int(out, -1, 4);
+                continue;
+            }
+            std::string field(value);
+            put_int(out, (long long)field.size(), 4);
+            out += field;
+        }
+    }
+    put_int(out, -1, 2);
+    return out;
+}
+
+// ,          step 
+static size_t scan(CopyStreamScanner& scanner, const std::string& data, size_t step) {
+    size_t consumed = 0;
+    for (size_t pos = 0; pos < data.size() && !scanner.done(); pos += step) {
+        size_t length = std::min(step, data.size() - pos);
+        size_t n = scanner.feed(data.data() + pos, length);
+        consumed += n;
+        if (n < length)
+            break;
+    }
+    return consumed;
+}
+
+static void test_stream_boundaries() {
+    std::string first = copy_stream({ { "1", "alpha" }, { "2", nullptr }, { "3", "" }, {} });
+    std::string second = copy_stream({ { "4", "beta" } }, std::string("\0\0\0\1x", 5));
+    std::string data = first + second;
+
+    //     ,     
+    for (size_t step : { (size_t)1, (size_t)2, (size_t)3, (size_t)7, (size_t)19, data.size() }) {
+        CopyStreamScanner scanner;
+        CHECK(scan(scanner, data, step) == first.size());
+        CHECK(scanner.done());
+        CHECK(scanner.feed(data.data() + first.size(), 1) == 0);
+
+        //  ,      ,  reset
+        scanner.reset();
+        CHECK(!scanner.done());
+        CHECK(scan(scanner, second, step) == second.size());
+        CHECK(scanner.done());
+    }
+}
+
+static void test_incomplete_stream() {
+    std::string stream = copy_stream({ { "1", "alpha" } });
+    CopyStreamScanner scanner;
+    CHECK(scanner.feed(stream.data(), stream.size() - 1) == stream.size() - 1);
+    CHECK(!scanner.done());
+    CHECK(scanner.feed(stream.data() + stream.size() - 1, 1) == 1);
+    CHECK(scanner.done());
+}
+
+static void test_invalid_header() {
+    std::string stream = copy_stream({});
+    stream[0] = 'X';
+    CopyStreamScanner scanner;
+    CHECK_THROWS(scanner.feed(stream.data(), stream.size()));
+}
+
+int main() {
+    test_stream_boundaries();
+    test_incomplete_stream();
+    test_invalid_header();
+    return test_result();
+}
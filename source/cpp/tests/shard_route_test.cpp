@@ -0,0 +1,78 @@
+#include "database_migrator.h"
+#include "test_check.h"
+#include <climits>
+#include <cstring>
+#include <string>
+
+static int route(const ShardConfig& shard, const char* value) {
+    return shard.route(value, value ? (int)strlen(value) : 0);
+}
+
+static void test_range() {
+    ShardConfig shard;
+    shard = json{ { "key", "id" }, { "method", "range" }, { "targets", json::array({ "a", "b", "c" }) },
+        { "bounds", json::array({ -100, 1000 }) } };
+
+    //    
+    CHECK(route(shard, "-101") == 0);
+    CHECK(route(shard, "-100") == 1);
+    CHECK(route(shard, "0") == 1);
+    CHECK(route(shard, "+999") == 1);
+    CHECK(route(shard, "1000") == 2);
+    CHECK(route(shard, nullptr) == 0);
+
+    //   bigint
+    CHECK(route(shard, std::to_string(LLONG_MAX).c_str()) == 2);
+    CHECK(route(shard, std::to_string(LLONG_MIN).c_str()) == 0);
+    CHECK(route(shard, "9223372036854775806") == 2);
+    CHECK_THROWS(route(shard, "9223372036854775808"));
+    CHECK_THROWS(route(shard, "-9223372036854775809"));
+
+    CHECK_THROWS(route(shard, ""));
+    CHECK_THROWS(route(shard, "+"));
+    CHECK_THROWS(route(shard, "-"));
+    CHECK_THROWS(route(shard, "+-1"));
+    CHECK_THROWS(route(shard, "12a"));
+    CHECK_THROWS(route(shard, " 12"));
+    CHECK_THROWS(route(shard, "1.5"));
+
+    //    ,    
+    CHECK(shard.route("10001", 2) == 1);
+}
+
+static void test_hash() {
+    ShardConfig shard;
+    shard = json{ { "key", "id" }, { "targets", json::array({ "a", "b", "c", "d" }) } };
+
+    // FNV-1a:       
+    CHECK(route(shard, "") == (int)(14695981039346656037ULL % 4));
+    CHECK(route(shard, nullptr) == 0);
+
+    int counts[4] = { 0 };
+    for (int i = 0; i < 4000; i++) {
+        int number = route(shard, std::to_string(i).c_str());
+        CHECK(number >= 0 && number < 4);
+        if (number >= 0 && number < 4)
+            counts[number]++;
+        CHECK(route(shard, std::to_string(i).c_str()) == number);
+    }
+    for (int count : counts)
+        CHECK(count > 800 && count < 1200);
+}
+
+static void test_config() {
+    ShardConfig shard;
+    CHECK(!shard.enabled());
+    CHECK_THROWS((shard = json{ { "key", "id" }, { "targets", json::array({ "a" }) } }));
+    CHECK_THROWS((shard = json{ { "key", "id" }, { "method", "range" }, { "targets", json::array({ "a", "b" }) } }));
+    CHECK_THROWS((shard = json{ { "key", "id" }, { "method", "range" }, { "targets", json::array({ "a", "b", "c" }) },
+        { "bounds", json::array({ 5, 5 }) } }));
+    CHECK_THROWS((shard = json{ { "key", "id" }, { "method", "list" }, { "targets", json::array({ "a", "b" }) } }));
+}
+
+int main() {
+    test_range();
+    test_hash();
+    test_config();
+    return test_result();
+}
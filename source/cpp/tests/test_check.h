@@ -0,0 +1,48 @@
+/*
+* ================== TEST_CHECK ==================
+*      :
+*   - CHECK - ;      
+*      
+*   - CHECK_THROWS -    
+* test_result() -     ctest.
+*/
+
+#pragma once
+
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <iostream>
+#include <stdexcept>
+
+inline int& test_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+inline int test_result() {
+    if (test_failures() > 0)
+        std::cerr << test_failures() << " check(s) failed" << std::endl;
+    return test_failures() == 0 ? 0 : 1;
+}
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            test_failures()++; \
+        } \
+    } while (0)
+
+#define CHECK_THROWS(expression) \
+    do { \
+        bool thrown = false; \
+        try { expression; } \
+        catch (const std::exception&) { thrown = true; } \
+        if (!thrown) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_THROWS(" #expression ") didn't throw" << std::endl; \
+            test_failures()++; \
+        } \
+    } while (0)
+
+#endif // TEST_CHECK_H
@@ -0,0 +1,93 @@
+#include "table_writer.h"
+#include "test_check.h"
+#include <cstring>
+
+//      INSERT,   UpsertWriter::write
+static std::vector<int> slots(ConflictKeyIndex& index, const RowBatch& batch) {
+    std::vector<int> result;
+    int count = 0;
+    for (int row = 0; row < batch.rows(); row++) {
+        int slot = index.slot(batch, row, count);
+        result.push_back(slot);
+        if (slot == count)
+            count++;
+    }
+    return result;
+}
+
+static void add_row(RowBatch& batch, const char* key, const char* value) {
+    if (key)
+        batch.add_value(key, (int)strlen(key));
+    else
+        batch.add_null();
+    batch.add_value(value, (int)strlen(value));
+}
+
+static void test_conflict_key_index() {
+    RowBatch batch;
+    batch.reset(2);
+    add_row(batch, "1", "a");
+    add_row(batch, "2", "b");
+    add_row(batch, "1", "c");
+    add_row(batch, nullptr, "d");
+    add_row(batch, nullptr, "e");
+    add_row(batch, "2", "f");
+
+    //      ,   NULL    
+    ConflictKeyIndex index({ 0 });
+    CHECK(index.enabled());
+    CHECK((slots(index, batch) == std::vector<int>{ 0, 1, 0, 2, 3, 1 }));
+
+    //   INSERT     
+    index.clear();
+    CHECK(index.slot(batch, 2, 0) == 0);
+
+    ConflictKeyIndex disabled({});
+    CHECK(!disabled.enabled());
+    CHECK((slots(disabled, batch) == std::vector<int>{ 0, 1, 2, 3, 4, 5 }));
+}
+
+static void test_conflict_key_bytes() {
+    //    :      ("ab" + "c" != "a" + "bc")
+    RowBatch batch;
+    batch.reset(2);
+    batch.add_value("ab", 2);
+    batch.add_value("c", 1);
+    batch.add_value("a", 1);
+    batch.add_value("bc", 2);
+    ConflictKeyIndex index({ 0, 1 });
+    CHECK((slots(index, batch) == std::vector<int>{ 0, 1 }));
+
+    //   numeric,        -   
+    RowBatch numbers;
+    numbers.reset(1);
+    numbers.add_value("1.0", 3);
+    numbers.add_value("1.00", 4);
+    ConflictKeyIndex numeric({ 0 });
+    CHECK((slots(numeric, numbers) == std::vector<int>{ 0, 1 }));
+}
+
+static void test_upsert_query() {
+    UpsertConfig upsert;
+    upsert = json{ { "conflict_key", "id" } };
+
+    CHECK(build_upsert_query("public.t", { "id", "val" }, {}, {}, 2, upsert) ==
+        "INSERT INTO public.t (id, val) VALUES ($1,$2),($3,$4) ON CONFLICT (id) DO UPDATE SET val = EXCLUDED.val");
+
+    CHECK(build_upsert_query("public.t", { "id", "val" }, { "numeric", "text" }, { 0 }, 2, upsert) ==
+        "INSERT INTO public.t (id, val) SELECT DISTINCT ON (v.id, CASE WHEN v.id IS NULL THEN v.migrator_row END) "
+        "v.id, v.val FROM (VALUES ($1::numeric,$2::text,0),($3::numeric,$4::text,1)) AS v (id, val, migrator_row) "
+        "ORDER BY v.id, CASE WHEN v.id IS NULL THEN v.migrator_row END, v.migrator_row DESC "
+        "ON CONFLICT (id) DO UPDATE SET val = EXCLUDED.val");
+
+    upsert = json{ { "conflict_key", json::array({ "a", "b" }) }, { "on_conflict", "nothing" } };
+    CHECK(build_upsert_query("t", { "a", "b" }, {}, {}, 1, upsert) ==
+        "INSERT INTO t (a, b) VALUES ($1,$2) ON CONFLICT (a, b) DO NOTHING");
+}
+
+int main() {
+    test_conflict_key_index();
+    test_conflict_key_bytes();
+    test_upsert_query();
+    return test_result();
+}
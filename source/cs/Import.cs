@@ -29,6 +29,9 @@ namespace DDL_MigratorGUI
         [DllImport(DatabaseManagerDLLPath, CallingConvention = CallingConvention.Cdecl)]
         public static extern bool ExecuteMigration(IntPtr migrator);
 
+        [DllImport(DatabaseManagerDLLPath, CallingConvention = CallingConvention.Cdecl)]
+        public static extern bool VerifyMigration(IntPtr migrator);
+
 
         [DllImport(DatabaseManagerDLLPath, CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr ConnectDatabase(string connection_string);